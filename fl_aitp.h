@@ -0,0 +1,232 @@
+#ifndef FL_AITP_H
+#define FL_AITP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------- Embedding API ----------------
+// In-process entry point of fl_aitp_simulation.cc. Build that file with
+// FL_AITP_NO_MAIN defined next to the calling tool (for example in an ns-3
+// scratch subdirectory), then call RunScenario() repeatedly: results come
+// back as typed vectors and nothing is written to disk.
+
+// ---------------- Simulation Parameters ----------------
+struct SimulationParams {
+    uint32_t nSta = 500;
+    double simTime = 10.0;
+    double dpEpsilon = 1.0;
+    std::string compression = "none"; // none, gzip or zstd
+    int compressionLevel = 3;
+    int csvPrecision = 0; // 0 = shortest round-trip, at most 17
+    uint32_t asyncQueue = 0; // background writer queue size; 0 = synchronous
+    uint32_t seed = 1;
+    uint64_t run = 1;
+    std::string outputPrefix;  // prepended to every result file name
+    std::string scenarioFile;  // one scenario (command-line overrides) per line
+    std::vector<std::string> modes = {"AITP", "CAIP", "NAP"};
+    std::vector<uint32_t> nStaValues = {50, 100, 200, 300, 400, 500};
+
+    // Packet-level FL traffic (one run per mode when enabled)
+    bool packetLevel = false;
+    uint32_t modelBytes = 100000;      // uncompressed update size
+    uint32_t chunkBytes = 1000;        // payload per FL message
+    std::string uploadOrder = "sequential"; // sequential or importance (prefix aggregated at the deadline)
+    double importanceExponent = 0.3;   // importance: a prefix of fraction x carries x^exponent of the value
+    double trainTime = 0.0;            // local training of the full model on the fastest client (s)
+    double computeSpread = 1.0;        // client compute slowdown, uniform in [1, spread]
+    std::string submodel = "full";     // full or dropout (sub-model sized to link rate and compute)
+    double submodelBudget = 0.8;       // dropout: share of the round deadline a client may use
+    double submodelMin = 0.25;         // dropout: smallest sub-model fraction
+    uint32_t submodelBlocks = 64;      // dropout: model blocks tracked for reconstruction
+    double roundDeadline = 2.0;        // s
+    double areaRadius = 30.0;          // STA disc around the origin (m)
+    uint32_t nAp = 1;                  // >1: APs on a bridged backbone with the server
+    double apSpacing = 100.0;          // distance between neighbouring APs (m)
+    std::string apLayout = "line";     // line (STAs in the areaRadius disc) or grid (dense multi-BSS)
+    uint16_t channelWidth = 0;         // MHz: 20, 40, 80 or 160; 0 = standard default (not with bands)
+    double hiddenFraction = -1.0;      // hidden-terminal scenario: STAs placed opposite the rest; <0 = off
+    double hiddenRange = 50.0;         // hidden scenario: radio range of every node (m)
+    std::string rtsCts = "off";        // RTS/CTS policy: off, always or a byte threshold, optionally per mode ("AITP:always,off")
+    std::string phyModel = "table";    // frame errors: table (ns-3 AWGN tables at the mean SINR), eesm or miesm
+    double phyCoherenceMhz = 5.0;      // eesm/miesm: independently faded subband width (MHz)
+    double obssPdLevel = 0.0;          // HE spatial reuse: OBSS-PD level (dBm, -82..-62) with BSS colours; 0 = off
+    double staSpeed = 0.0;             // waypoint speed (m/s); 0 = ns-3 default
+    std::string handoverPolicy = "resume"; // resume or restart the upload after roaming
+    std::string bands;                 // radios per node, "GHz:MHz,..." e.g. "2.4:20,5:80,6:160"; empty = one default channel
+    std::string bandSplit = "capacity"; // multi-band upload split: first, even, capacity or adaptive
+    std::string flTopology = "infra";  // infra (server behind the AP) or adhoc (gossip, no AP)
+    std::string gossipPeers = "random"; // random, nearest or roundrobin
+    uint32_t gossipFanout = 1;         // peers per station and gossip round
+    double gossipRange = 0.0;          // max peer distance (m); 0 = any station
+    std::string flProtocol = "fedavg"; // fedavg (whole-model uploads) or split (split learning)
+    uint32_t splitBatches = 20;        // split: mini-batches per client and round
+    uint32_t activationBytes = 8192;   // split: cut-layer activations per batch
+    uint32_t gradientBytes = 8192;     // split: cut-layer gradients per batch
+    double clientComputeTime = 0.005;  // split: client forward/backward per batch (s)
+    double serverComputeTime = 0.001;  // split: server layers per batch (s)
+    std::string jobs;                  // "name:modelBytes:roundDeadline:clientFraction:weight,..."; empty = one job
+    std::string jobScheduling = "drr"; // airtime scheduling across jobs: drr or none
+    double jobQuantum = 0.005;         // job scheduler quantum (s)
+    uint32_t clusters = 0;             // clustered FL: models kept by the AP; 0 = one global model
+    uint32_t clusterDim = 256;         // clustered: floats per update sketch
+    uint32_t clusterGroups = 4;        // clustered: client populations (client id mod groups)
+    double clusterNoise = 1.0;         // clustered: sketch noise around the population centre
+    uint32_t clusterBatch = 64;        // clustered: mini-batch k-means batch size
+    uint32_t clusterIterations = 20;   // clustered: mini-batch k-means iterations per round
+    double downlinkRate = 5.0;         // clustered: pacing of the cluster-model broadcasts (Mb/s)
+    std::string joinSchedule = "all";  // all, staggered, random or batched
+    double joinInterval = 0.01;        // staggered: per STA, batched: per batch (s)
+    double joinWindow = 2.0;           // random: joins uniform over [0, window] (s)
+    uint32_t joinBatchSize = 50;
+    double flStartFraction = 1.0;      // associated fraction that starts FL
+    double flStartTimeout = 5.0;       // FL starts by this time regardless (s)
+    uint32_t mserBatch = 5;            // batch size of MSER warm-up truncation
+    double goodputBin = 0.1;           // bin width of the goodput series (s)
+    bool staticArp = false;            // pre-populate every ARP cache at start-up (no ARP exchanges)
+    bool perClient = false;            // write results_<mode>_clients.flcol
+    double staBatteryJ = 10000.0;      // initial STA battery energy (J)
+    double metricsWindow = 0.5;        // time-series window (s); 0 disables
+    uint32_t metricsCapacity = 1024;   // windows kept; older ones are overwritten
+    bool liveTrace = false;            // stream every window to results_<mode>_live.csv while the run is in progress
+
+    // Client availability (STAs switch their radio off while unavailable)
+    std::string availability = "always"; // always, diurnal or trace
+    double dayLength = 0.0;            // simulated seconds per 24 h; 0 = simTime
+    double dayStartHour = 0.0;         // hour of day at t = 0
+    double diurnalBase = 0.5;          // mean availability probability
+    double diurnalAmplitude = 0.4;     // swing around the mean
+    double diurnalPeakHour = 2.0;      // hour of highest availability
+    double availabilitySlot = 0.0;     // churn step (s); 0 = one simulated hour
+    double churnRate = 0.5;            // 1 = independent draw each slot, lower = stickier
+    std::string availabilityTrace;     // lines "clientId start end" (s)
+};
+
+// ---------------- Results ----------------
+// Per-client totals of one packet-level run.
+struct ClientRecord {
+    uint32_t roundsSelected = 0;
+    uint32_t updatesCompleted = 0;
+    uint64_t bytesSent = 0;   // FL messages handed to TCP, headers included
+    uint64_t rxBytes = 0;     // FL payload from this client received by the server (or peers)
+    double goodputMbps = 0.0; // rxBytes over the FL period
+    double energyJ = 0.0;     // radio energy consumed
+    double latencyP50 = 0.0;  // update latency percentiles (s)
+    double latencyP90 = 0.0;
+    double latencyP99 = 0.0;
+    uint32_t drops = 0;       // MAC frames dropped (queue or retry limit)
+    uint32_t handovers = 0;   // re-associations with a different AP
+    uint64_t lostBytes = 0;   // update payload discarded by restarts or roaming
+    double airtimeS = 0.0;    // time the STA radio spent transmitting
+};
+
+// One time-series window, stamped with its end time.
+struct WindowSample {
+    double time = 0.0;           // s
+    double throughputMbps = 0.0; // FL payload received by the server
+    double meanLatency = 0.0;    // updates completed in the window (s); 0 if none
+    double energyJ = 0.0;        // radio energy drained by all STAs and the AP
+    uint32_t activeClients = 0;  // clients with FL data received in the window
+};
+
+// One radio band of a multi-band run (params.bands).
+struct BandResult {
+    double ghz = 0.0;
+    uint32_t widthMhz = 0;
+    uint64_t rxBytes = 0;  // FL payload received over this band
+    double apTxS = 0.0;    // AP radio transmitting
+    double staTxS = 0.0;   // all STA radios transmitting
+    double busyS = 0.0;    // AP radio not idle (TX, RX or CCA busy)
+};
+
+// Measurements of one packet-level run at params.nSta.
+struct PacketLevelResult {
+    std::vector<double> assocDelay;       // per STA, join to association (s); -1 if never
+    double flStartTime = 0.0;             // s
+    std::vector<double> roundStart;       // per round (s)
+    std::vector<double> roundLatency;     // per round (s)
+    std::vector<uint32_t> roundAvailable; // available clients at round start
+    std::vector<uint32_t> roundSelected;  // clients asked for an update
+    std::vector<uint32_t> roundCompleted; // clients whose update arrived in time
+    std::vector<uint32_t> roundPartial;   // importance order: cut-off updates aggregated as a prefix
+    std::vector<double> roundReceived;    // update payload that arrived, per selected client (fraction)
+    std::vector<double> roundImportance;  // update value captured, per selected client (fraction)
+    std::vector<double> roundSubmodel;    // mean sub-model fraction of the selected clients
+    std::vector<double> roundCoverage;    // model blocks trained by at least one completed update
+    std::vector<double> roundMinCover;    // fewest completed updates behind any block
+    uint64_t rxBytes = 0;                 // FL payload bytes received by the server
+    uint64_t txBytes = 0;                 // FL payload bytes sent by the server (gradients, cluster models)
+    uint64_t modelRxBytes = 0;            // clustered: own-cluster model bytes received by clients
+    double apAirtime = 0.0;               // time the AP radios spent transmitting (s)
+    double goodputMbps = 0.0;             // rxBytes over [flStartTime, simTime]
+    std::vector<double> updateLatency;    // per completed update, arrival order (s)
+    std::vector<double> handoverGap;      // per handover, deassociation to association (s)
+    std::vector<double> roundSpread;      // gossip: std dev of station models at round end
+    std::vector<double> batchRtt;         // split: activation sent to gradient received (s)
+    std::vector<uint32_t> roundClustered; // clustered: sketches clustered at round end
+    std::vector<uint32_t> roundModelsRx;  // clustered: clients that got their cluster model's last chunk
+    std::vector<double> clusterPurity;    // clustered: clients sharing their cluster's majority population
+    std::vector<double> clusterTimeMs;    // clustered: wall-clock k-means fit + assignment (ms)
+    std::vector<double> goodputSeries;    // Mbps per goodputBin since flStartTime
+    std::vector<ClientRecord> clients;    // indexed by client id
+    std::vector<BandResult> bands;        // multi-band runs only
+    double hiddenPairs = 0.0;             // hidden scenario: STA pairs out of each other's range (fraction)
+    uint64_t staTxAttempts = 0;           // PHY transmissions started by STAs
+    uint64_t dataFailures = 0;            // STA data frames without ACK
+    uint64_t rtsFailures = 0;             // STA RTS frames without CTS
+    uint64_t apRxFrames = 0;              // frames the AP PHYs received correctly
+    uint64_t apRxDropped = 0;             // frames the AP PHYs started but dropped (errors, collisions)
+    double wallS = 0.0;                   // wall-clock time of the simulation run (s)
+    uint64_t arpFrames = 0;               // ARP requests and replies handed to the wifi MACs
+    uint64_t arpBytes = 0;                // their size, LLC/SNAP header included
+    std::vector<WindowSample> timeSeries; // newest metricsCapacity windows
+};
+
+// One FL job of a multi-job run (params.jobs).
+struct JobResult {
+    std::string name;
+    double weight = 1.0;
+    uint32_t clients = 0;         // STAs in the job
+    double airtimeGranted = 0.0;  // airtime admitted by the AP job scheduler (s)
+    double airtimeMeasured = 0.0; // PHY-measured STA airtime, split between a STA's jobs by bytes sent (s)
+    PacketLevelResult result;     // clients indexed by position in the job
+};
+
+// Metric vectors are indexed like ResultSet::nStaValues.
+struct ModeResult {
+    std::string mode;
+    std::vector<double> latency;
+    std::vector<double> throughput;
+    std::vector<double> energyEfficiency;
+    std::vector<double> privacyLoss;
+    std::vector<double> robustness;
+    PacketLevelResult packetLevel; // filled when params.packetLevel is set (first job)
+    std::vector<JobResult> jobs;   // every job, when params.jobs is set
+};
+
+struct ResultSet {
+    std::vector<uint32_t> nStaValues;
+    std::vector<ModeResult> modes;
+
+    const ModeResult *Find(const std::string &mode) const {
+        for (const ModeResult &result : modes) {
+            if (result.mode == mode) {
+                return &result;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Builds the topology for params, computes every metric for every mode,
+// runs the simulator and tears it down with Simulator::Destroy(). RNGs are
+// reseeded from params.seed/params.run and stream numbering restarts, so
+// equal params give equal results. Aborts on out-of-range settings
+// (chunkBytes, compression, csvPrecision) as the command line does.
+ResultSet RunScenario(const SimulationParams &params);
+
+// Restores attribute defaults and closes open outputs. Call between
+// scenarios when earlier runs changed ns-3 defaults via Config::SetDefault.
+void ResetGlobalState();
+
+#endif // FL_AITP_H
@@ -5,8 +5,23 @@
 #include "ns3/wifi-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/bridge-module.h"
+#include "ns3/csma-module.h"
 #include "ns3/config-store.h"
+#include "fl_aitp.h"
+#include "fl_client_table.h"
+#include "fl_cluster.h"
+#include "fl_message.h"
+#include "fl_output.h"
+#include "fl_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
 #include <random>
 #include <vector>
 
@@ -16,37 +31,121 @@ using namespace ns3::energy;
 NS_LOG_COMPONENT_DEFINE("FL_AITP_Simulation");
 
 // ---------------- Logging Helpers ----------------
+static OutputRegistry &GetOutputs() {
+    static OutputRegistry outputs;
+    return outputs;
+}
+
 static void LogToCsv(std::string filename, std::string header, const std::vector<double>& values) {
-    static std::map<std::string, bool> initialized;
-    std::ofstream out;
-    if (!initialized[filename]) {
-        out.open(filename, std::ios::out);
-        out << header << std::endl;
-        initialized[filename] = true;
-    } else {
-        out.open(filename, std::ios::app);
+    static CsvLine line;
+    bool created;
+    OutputSink &out = GetOutputs().Get(filename, created);
+    NS_ABORT_MSG_IF(!out.IsOpen(), "Cannot open output " << out.Path());
+    line.SetPrecision(GetOutputs().GetOptions().precision);
+    line.Clear();
+    if (created) {
+        line.Append(header);
+        line.Append('\n');
     }
     for (double value : values) {
-        out << value << ",";
+        line.Append(value);
+        line.Append(',');
+    }
+    line.Append('\n');
+    GetOutputs().Write(out, line.Str());
+}
+
+// Scheduled with Simulator::ScheduleDestroy so queued records reach disk
+// before Simulator::Destroy() returns.
+static void FlushOutputs() {
+    GetOutputs().Flush();
+}
+
+// Reports the async writer counters once per scenario: CloseAll drains the
+// writer, and taking the counters restarts them for the next scenario.
+static void CloseOutputs() {
+    std::string failed = GetOutputs().CloseAll();
+    if (!failed.empty()) {
+        NS_LOG_UNCOND("Output writer reported errors for: " << failed);
+    }
+    AsyncOutputWriter::Stats stats = GetOutputs().TakeAsyncStats();
+    if (stats.records > 0) {
+        NS_LOG_UNCOND("Async writer: records=" << stats.records << " fullStalls=" << stats.fullStalls
+                      << " stallUs=" << stats.stallMicros << " maxOccupancy=" << stats.maxOccupancy);
     }
-    out << std::endl;
-    out.close();
 }
 
-// ---------------- Simulation Parameters ----------------
-struct SimulationParams {
-    uint32_t nSta = 500;
-    double simTime = 10.0;
-    double dpEpsilon = 1.0;
-    std::vector<std::string> modes = {"AITP", "CAIP", "NAP"};
-    std::vector<uint32_t> nStaValues = {50, 100, 200, 300, 400, 500};
+// ---------------- FL Message Header ----------------
+// ns-3 Header wrapper around the fixed layout in fl_message.h. Senders use
+// it with Packet::AddHeader; receivers that only need a few fields can copy
+// the first kFlMessageSize bytes and read them through FlMessageView.
+class FlUpdateHeader : public Header {
+public:
+    FlUpdateHeader() = default;
+    explicit FlUpdateHeader(const FlMessageFields &fields) : m_fields(fields) {}
+
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::FlUpdateHeader")
+                                .SetParent<Header>()
+                                .SetGroupName("Applications")
+                                .AddConstructor<FlUpdateHeader>();
+        return tid;
+    }
+
+    TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+    uint32_t GetSerializedSize() const override { return kFlMessageSize; }
+
+    void Serialize(Buffer::Iterator start) const override {
+        uint8_t buf[kFlMessageSize];
+        WriteFlMessage(buf, m_fields);
+        start.Write(buf, kFlMessageSize);
+    }
+
+    uint32_t Deserialize(Buffer::Iterator start) override {
+        uint8_t buf[kFlMessageSize];
+        start.Read(buf, kFlMessageSize);
+        FlMessageView view(buf, kFlMessageSize);
+        NS_ASSERT_MSG(view.IsValid(), "Bad FL message header");
+        m_fields.type = view.Type();
+        m_fields.clientId = view.ClientId();
+        m_fields.round = view.Round();
+        m_fields.modelVersion = view.ModelVersion();
+        m_fields.rawBytes = view.RawBytes();
+        m_fields.payloadBytes = view.PayloadBytes();
+        m_fields.chunkOffset = view.ChunkOffset();
+        m_fields.chunkBytes = view.ChunkBytes();
+        m_fields.codec = view.Codec();
+        m_fields.flags = view.Flags();
+        m_fields.dpEpsilon = view.DpEpsilon();
+        m_fields.dpDelta = view.DpDelta();
+        m_fields.dpNoiseMultiplier = view.DpNoiseMultiplier();
+        m_fields.dpClipNorm = view.DpClipNorm();
+        return kFlMessageSize;
+    }
+
+    void Print(std::ostream &os) const override {
+        os << "client=" << m_fields.clientId << " round=" << m_fields.round
+           << " version=" << m_fields.modelVersion << " offset=" << m_fields.chunkOffset
+           << " bytes=" << m_fields.chunkBytes << "/" << m_fields.payloadBytes;
+    }
+
+    const FlMessageFields &GetFields() const { return m_fields; }
+
+private:
+    FlMessageFields m_fields;
 };
 
+NS_OBJECT_ENSURE_REGISTERED(FlUpdateHeader);
+
 // ---------------- Metric Functions ----------------
-double GetRandomFailureRate() {
+static std::default_random_engine &GetFailureRng() {
     static std::default_random_engine gen;
+    return gen;
+}
+
+double GetRandomFailureRate() {
     static std::uniform_real_distribution<double> dist(0.0, 1.0);
-    return dist(gen);
+    return dist(GetFailureRng());
 }
 
 std::vector<double> ComputeLatency(const SimulationParams &params, const std::string &mode, uint32_t nSta) {
@@ -125,87 +224,3342 @@ std::vector<double> ComputeRobustness(const SimulationParams &params, const std:
     return robustnesses;
 }
 
-// ---------------- Main Simulation ----------------
-int main(int argc, char *argv[]) {
-    SimulationParams params;
+// ---------------- FL Applications ----------------
+// Incremental parser for a TCP byte stream of FL messages. Only the header
+// bytes of each message are copied out of the packet; payload bytes are
+// counted and skipped in place.
+class FlStreamParser {
+public:
+    // Calls onMessage(FlMessageView) for every message completed by packet.
+    template <typename F>
+    void Feed(Ptr<const Packet> packet, F onMessage) {
+        uint32_t pos = 0;
+        uint32_t size = packet->GetSize();
+        while (pos < size) {
+            uint32_t left = size - pos;
+            if (m_payloadLeft > 0) {
+                uint32_t n = std::min(left, m_payloadLeft);
+                m_payloadLeft -= n;
+                pos += n;
+                if (m_payloadLeft == 0) {
+                    Deliver(onMessage);
+                }
+                continue;
+            }
+            uint32_t n = std::min(left, kFlMessageSize - m_headerFill);
+            // A fragment shares the packet's buffer, so only n bytes move.
+            packet->CreateFragment(pos, n)->CopyData(m_header + m_headerFill, n);
+            m_headerFill += n;
+            pos += n;
+            if (m_headerFill == kFlMessageSize) {
+                FlMessageView msg(m_header, kFlMessageSize);
+                NS_ASSERT_MSG(msg.IsValid(), "Corrupt FL stream");
+                m_payloadLeft = msg.ChunkBytes();
+                if (m_payloadLeft == 0) {
+                    Deliver(onMessage);
+                }
+            }
+        }
+    }
 
-    CommandLine cmd;
-    cmd.AddValue("nSta", "Number of stations", params.nSta);
-    cmd.AddValue("dpEpsilon", "Differential privacy budget ε", params.dpEpsilon);
-    cmd.Parse(argc, argv);
+private:
+    template <typename F>
+    void Deliver(F onMessage) {
+        onMessage(FlMessageView(m_header, kFlMessageSize));
+        m_headerFill = 0;
+    }
 
-    NS_LOG_UNCOND("Running simulation with nSta=" << params.nSta << ", dpEpsilon=" << params.dpEpsilon);
+    uint8_t m_header[kFlMessageSize];
+    uint32_t m_headerFill = 0;
+    uint32_t m_payloadLeft = 0;
+};
 
-    // ---------------- Network Topology ----------------
-    NodeContainer wifiStaNodes;
-    wifiStaNodes.Create(params.nSta);
-    NodeContainer wifiApNode;
-    wifiApNode.Create(1);
+// Writes message to a TCP socket split into FL messages of at most
+// chunkBytes payload, starting at payload offset and stopping when the
+// socket's send buffer is full. Returns true once the last chunk is queued;
+// otherwise offset is where to resume.
+static bool SendFlMessage(Ptr<Socket> socket, const FlMessageFields &message, uint32_t chunkBytes, uint32_t &offset) {
+    do {
+        uint32_t chunk = std::min(chunkBytes, message.payloadBytes - offset);
+        if (socket->GetTxAvailable() < kFlMessageSize + chunk) {
+            return false;
+        }
+        FlMessageFields fields = message;
+        fields.chunkOffset = offset;
+        fields.chunkBytes = static_cast<uint16_t>(chunk);
+        if (offset + chunk == message.payloadBytes) {
+            fields.flags |= FL_FLAG_LAST_CHUNK;
+        }
+        Ptr<Packet> packet = Create<Packet>(chunk);
+        packet->AddHeader(FlUpdateHeader(fields));
+        socket->Send(packet);
+        offset += chunk;
+    } while (offset < message.payloadBytes);
+    return true;
+}
 
-    YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
-    YansWifiPhyHelper phy;
-    phy.SetChannel(channel.Create());
+// Server at the AP. Clients stream their update as a sequence of FL
+// messages (FlUpdateHeader + chunk payload) over TCP; the server walks the
+// byte stream, keeps only the 48 header bytes of each message and reads
+// them in place through FlMessageView. Payload bytes are counted, not copied.
+// A client that reconnects supersedes its older connections: messages still
+// draining from those are dropped. SendToClient answers on the newest one,
+// finishing from the send callback what the send buffer could not take;
+// Broadcast sends a message to every STA as UDP datagrams.
+class FlServerApp : public Application {
+public:
+    typedef void (*ChunkRxCallback)(const FlMessageView &msg);
 
-    WifiMacHelper mac;
-    WifiHelper wifi;
-    wifi.SetStandard(WIFI_STANDARD_80211ax);
-    wifi.SetRemoteStationManager("ns3::IdealWifiManager");
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::FlServerApp")
+                                .SetParent<Application>()
+                                .SetGroupName("Applications")
+                                .AddConstructor<FlServerApp>()
+                                .AddAttribute("Port", "TCP port to listen on",
+                                              UintegerValue(9000),
+                                              MakeUintegerAccessor(&FlServerApp::m_port),
+                                              MakeUintegerChecker<uint16_t>())
+                                .AddTraceSource("ChunkRx", "A complete FL message was received",
+                                                MakeTraceSourceAccessor(&FlServerApp::m_chunkRx),
+                                                "ns3::FlServerApp::ChunkRxCallback");
+        return tid;
+    }
 
-    Ssid ssid = Ssid("ns3-wifi");
-    mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid), "ActiveProbing", BooleanValue(false));
-    NetDeviceContainer staDevices = wifi.Install(phy, mac, wifiStaNodes);
+    // Sends message to a client over its newest connection; chunks that do
+    // not fit the send buffer yet follow as it drains. A newer message to
+    // the same client replaces the rest of a pending one. Returns false if
+    // the client has no connection.
+    bool SendToClient(uint32_t clientId, const FlMessageFields &message, uint32_t chunkBytes) {
+        auto it = m_clientSocket.find(clientId);
+        if (it == m_clientSocket.end()) {
+            NS_LOG_DEBUG("FL server has no connection to client " << clientId);
+            return false;
+        }
+        TxState tx = {it->second, message, chunkBytes, 0};
+        if (SendFlMessage(tx.socket, tx.message, tx.chunkBytes, tx.offset)) {
+            m_tx.erase(clientId);
+        } else {
+            m_tx[clientId] = tx;
+        }
+        return true;
+    }
 
-    mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-    NetDeviceContainer apDevice = wifi.Install(phy, mac, wifiApNode);
+    // Broadcasts message to UDP port, one FL message per datagram, paced at
+    // rateMbps behind any broadcast still in progress so a large model does
+    // not overflow the AP queue.
+    void Broadcast(const FlMessageFields &message, uint32_t chunkBytes, uint16_t port, double rateMbps) {
+        if (!m_broadcastSocket) {
+            m_broadcastSocket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+            m_broadcastSocket->SetAllowBroadcast(true);
+            m_broadcastSocket->Bind();
+        }
+        Time at = std::max(Simulator::Now(), m_broadcastFree);
+        uint32_t offset = 0;
+        do {
+            uint32_t chunk = std::min(chunkBytes, message.payloadBytes - offset);
+            FlMessageFields fields = message;
+            fields.chunkOffset = offset;
+            fields.chunkBytes = static_cast<uint16_t>(chunk);
+            if (offset + chunk == message.payloadBytes) {
+                fields.flags |= FL_FLAG_LAST_CHUNK;
+            }
+            Simulator::Schedule(at - Simulator::Now(), &FlServerApp::SendDatagram, this, fields, port);
+            at += Seconds((kFlMessageSize + chunk) * 8.0 / (rateMbps * 1e6));
+            offset += chunk;
+        } while (offset < message.payloadBytes);
+        m_broadcastFree = at;
+    }
 
-    MobilityHelper mobility;
-    mobility.SetMobilityModel("ns3::RandomWaypointMobilityModel");
-    mobility.Install(wifiStaNodes);
-    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-    mobility.Install(wifiApNode);
+protected:
+    void DoDispose() override {
+        m_socket = nullptr;
+        m_broadcastSocket = nullptr;
+        m_rx.clear();
+        m_clientSocket.clear();
+        m_tx.clear();
+        Application::DoDispose();
+    }
 
-    InternetStackHelper stack;
-    stack.Install(wifiStaNodes);
-    stack.Install(wifiApNode);
+private:
+    struct RxState {
+        FlStreamParser parser;
+        uint64_t conn = 0; // accept order
+    };
 
-    Ipv4AddressHelper address;
-    address.SetBase("10.1.3.0", "255.255.255.0");
-    Ipv4InterfaceContainer staInterfaces = address.Assign(staDevices);
-    Ipv4InterfaceContainer apInterface = address.Assign(apDevice);
+    // Rest of a message to a client that the send buffer could not take.
+    struct TxState {
+        Ptr<Socket> socket;
+        FlMessageFields message;
+        uint32_t chunkBytes;
+        uint32_t offset; // next payload byte to queue
+    };
 
-    // ---------------- Energy Model ----------------
-    BasicEnergySourceHelper energySourceHelper;
-    energySourceHelper.Set("BasicEnergySupplyVoltageV", DoubleValue(3.0));
-    EnergySourceContainer sources = energySourceHelper.Install(wifiApNode);
+    void StartApplication() override {
+        m_socket = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
+        m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port));
+        m_socket->Listen();
+        m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
+                                    MakeCallback(&FlServerApp::HandleAccept, this));
+    }
 
-    WifiRadioEnergyModelHelper radioEnergyHelper;
-    DeviceEnergyModelContainer deviceModels = radioEnergyHelper.Install(apDevice, sources);
+    void StopApplication() override {
+        if (m_socket) {
+            m_socket->Close();
+        }
+    }
 
-    // ---------------- Metrics for All Modes ----------------
-    for (const auto& mode : params.modes) {
-        std::string prefix = "results_" + mode;
+    void HandleAccept(Ptr<Socket> socket, const Address &from) {
+        socket->SetRecvCallback(MakeCallback(&FlServerApp::HandleRead, this));
+        socket->SetSendCallback(MakeCallback(&FlServerApp::HandleSend, this));
+        RxState st;
+        st.conn = ++m_accepted;
+        m_rx[PeekPointer(socket)] = st;
+    }
 
-        // Compute metrics for varying nSta
-        std::vector<double> latencies = ComputeLatency(params, mode, params.nSta);
-        std::vector<double> throughputs = ComputeThroughput(params, mode, params.nSta);
-        std::vector<double> energyEfficiencies = ComputeEnergyEfficiency(params, mode, params.nSta);
-        std::vector<double> privacyLosses = ComputePrivacyLoss(params, mode, params.nSta);
-        std::vector<double> robustnesses = ComputeRobustness(params, mode, params.nSta);
+    void HandleRead(Ptr<Socket> socket) {
+        RxState &st = m_rx[PeekPointer(socket)];
+        Ptr<Packet> packet;
+        while ((packet = socket->Recv())) {
+            st.parser.Feed(packet, [&](const FlMessageView &msg) { Deliver(socket, st.conn, msg); });
+        }
+    }
 
-        // Log to CSV
-        std::string header = "nSta=50,nSta=100,nSta=200,nSta=300,nSta=400,nSta=500";
-        LogToCsv(prefix + "_latency.csv", header, latencies);
-        LogToCsv(prefix + "_throughput.csv", header, throughputs);
-        LogToCsv(prefix + "_energy.csv", header, energyEfficiencies);
-        LogToCsv(prefix + "_privacy.csv", header, privacyLosses);
-        LogToCsv(prefix + "_robustness.csv", header, robustnesses);
+    void HandleSend(Ptr<Socket> socket, uint32_t available) {
+        for (auto it = m_tx.begin(); it != m_tx.end();) {
+            TxState &tx = it->second;
+            if (tx.socket == socket && SendFlMessage(tx.socket, tx.message, tx.chunkBytes, tx.offset)) {
+                it = m_tx.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
 
-        NS_LOG_UNCOND("Metrics logged for mode=" << mode);
+    void SendDatagram(FlMessageFields fields, uint16_t port) {
+        Ptr<Packet> packet = Create<Packet>(fields.chunkBytes);
+        packet->AddHeader(FlUpdateHeader(fields));
+        m_broadcastSocket->SendTo(packet, 0, InetSocketAddress(Ipv4Address::GetBroadcast(), port));
     }
 
-    Simulator::Stop(Seconds(params.simTime));
-    Simulator::Run();
-    Simulator::Destroy();
+    void Deliver(Ptr<Socket> socket, uint64_t conn, const FlMessageView &msg) {
+        uint64_t &latest = m_latestConn[msg.ClientId()];
+        if (conn >= latest) {
+            latest = conn;
+            m_clientSocket[msg.ClientId()] = socket;
+            m_chunkRx(msg);
+        }
+    }
 
-    return 0;
-}
\ No newline at end of file
+    uint16_t m_port = 9000;
+    Ptr<Socket> m_socket;
+    std::map<Socket *, RxState> m_rx;
+    std::map<uint32_t, uint64_t> m_latestConn; // client id -> newest connection
+    std::map<uint32_t, Ptr<Socket>> m_clientSocket;
+    std::map<uint32_t, TxState> m_tx; // client id -> message still being queued
+    uint64_t m_accepted = 0;
+    TracedCallback<const FlMessageView &> m_chunkRx;
+    Ptr<Socket> m_broadcastSocket;
+    Time m_broadcastFree; // when the last scheduled datagram goes out
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FlServerApp);
+
+// Client on each STA. StartUpload queues one update; chunks are written to
+// the TCP socket as fast as its send buffer accepts them. Messages the
+// server sends back, and those it broadcasts to ListenBroadcast's port, are
+// reported through MessageRx.
+class FlClientApp : public Application {
+public:
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::FlClientApp")
+                                .SetParent<Application>()
+                                .SetGroupName("Applications")
+                                .AddConstructor<FlClientApp>()
+                                .AddTraceSource("MessageRx", "A complete FL message arrived from the server",
+                                                MakeTraceSourceAccessor(&FlClientApp::m_messageRx),
+                                                "ns3::FlServerApp::ChunkRxCallback");
+        return tid;
+    }
+
+    void Setup(const Address &server, uint32_t chunkBytes) {
+        m_server = server;
+        m_chunkBytes = chunkBytes;
+    }
+
+    // Receive the server's UDP broadcasts on port; call before the app starts.
+    void ListenBroadcast(uint16_t port) { m_broadcastPort = port; }
+
+    // fields carries everything but the per-chunk offset/length/flags.
+    void StartUpload(const FlMessageFields &fields) { StartUpload(fields, 0, fields.payloadBytes); }
+
+    // Uploads only payload bytes [begin, end); the last chunk of the range
+    // carries FL_FLAG_LAST_CHUNK. Used to split an update across links.
+    void StartUpload(const FlMessageFields &fields, uint32_t begin, uint32_t end) {
+        m_update = fields;
+        m_begin = begin;
+        m_end = end;
+        m_nextOffset = begin;
+        m_uploading = true;
+        m_roamedDuringUpload = false;
+        if (!m_socket) {
+            Connect();
+        } else if (m_connected) {
+            SendPending(m_socket, m_socket->GetTxAvailable());
+        }
+    }
+
+    // Stops queuing chunks of the current update; bytes already handed to
+    // TCP still drain and are discarded by the server as stale. An update
+    // abandoned after a handover counts as lost work.
+    void StopUpload() {
+        if (m_uploading && m_roamedDuringUpload) {
+            m_lostBytes += m_nextOffset - m_begin;
+        }
+        m_uploading = false;
+    }
+
+    // The server has the whole update: nothing is left to resend or lose.
+    void FinishUpload() { m_uploading = false; }
+
+    // The STA re-associated with a different AP. With resume the TCP
+    // connection simply continues over the backbone; with restart the
+    // client drops it and sends the current update again from offset 0.
+    void OnHandover(bool restart) {
+        m_roamedDuringUpload = m_uploading;
+        if (!restart || !m_uploading) {
+            return;
+        }
+        m_lostBytes += m_nextOffset - m_begin;
+        m_nextOffset = m_begin;
+        if (m_socket) {
+            m_socket->SetSendCallback(MakeNullCallback<void, Ptr<Socket>, uint32_t>());
+            m_socket->Close();
+        }
+        Connect();
+    }
+
+    // Optional admission check run before each chunk is queued with its
+    // size in bytes; a refused client waits until Resume() is called.
+    void SetGate(Callback<bool, uint32_t> gate) { m_gate = gate; }
+
+    void Resume() {
+        if (m_socket && m_connected) {
+            SendPending(m_socket, m_socket->GetTxAvailable());
+        }
+    }
+
+    uint64_t GetBytesSent() const { return m_bytesSent; }
+    uint64_t GetLostBytes() const { return m_lostBytes; }
+
+protected:
+    void DoDispose() override {
+        m_socket = nullptr;
+        m_broadcastSocket = nullptr;
+        Application::DoDispose();
+    }
+
+private:
+    void StartApplication() override {
+        if (m_broadcastPort != 0) {
+            m_broadcastSocket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+            m_broadcastSocket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_broadcastPort));
+            m_broadcastSocket->SetRecvCallback(MakeCallback(&FlClientApp::HandleBroadcast, this));
+        }
+    }
+
+    void StopApplication() override {
+        if (m_socket) {
+            m_socket->Close();
+        }
+        if (m_broadcastSocket) {
+            m_broadcastSocket->Close();
+        }
+    }
+
+    void Connect() {
+        m_socket = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
+        m_connected = false;
+        m_socket->Bind();
+        m_socket->SetConnectCallback(MakeCallback(&FlClientApp::ConnectionSucceeded, this),
+                                     MakeCallback(&FlClientApp::ConnectionFailed, this));
+        m_socket->SetSendCallback(MakeCallback(&FlClientApp::SendPending, this));
+        m_socket->SetRecvCallback(MakeCallback(&FlClientApp::HandleRead, this));
+        m_parser = FlStreamParser();
+        m_socket->Connect(m_server);
+    }
+
+    void HandleRead(Ptr<Socket> socket) {
+        Ptr<Packet> packet;
+        while ((packet = socket->Recv())) {
+            if (socket != m_socket) {
+                continue;
+            }
+            m_parser.Feed(packet, [this](const FlMessageView &msg) { m_messageRx(msg); });
+        }
+    }
+
+    // Every datagram holds exactly one FL message; only its header is copied.
+    void HandleBroadcast(Ptr<Socket> socket) {
+        Ptr<Packet> packet;
+        uint8_t header[kFlMessageSize];
+        while ((packet = socket->Recv())) {
+            FlMessageView msg(header, packet->CopyData(header, kFlMessageSize));
+            if (msg.IsValid()) {
+                m_messageRx(msg);
+            }
+        }
+    }
+
+    // Callbacks of a socket abandoned by a restart are ignored.
+    void ConnectionSucceeded(Ptr<Socket> socket) {
+        if (socket != m_socket) {
+            return;
+        }
+        m_connected = true;
+        SendPending(socket, socket->GetTxAvailable());
+    }
+
+    void ConnectionFailed(Ptr<Socket> socket) {
+        if (socket != m_socket) {
+            return;
+        }
+        NS_LOG_DEBUG("FL client on node " << GetNode()->GetId() << " failed to connect");
+        m_socket = nullptr;
+        m_connected = false;
+    }
+
+    void SendPending(Ptr<Socket> socket, uint32_t available) {
+        while (m_uploading && m_connected && m_nextOffset < m_end) {
+            uint32_t chunk = std::min(m_chunkBytes, m_end - m_nextOffset);
+            if (socket->GetTxAvailable() < kFlMessageSize + chunk) {
+                return;
+            }
+            if (!m_gate.IsNull() && !m_gate(kFlMessageSize + chunk)) {
+                return;
+            }
+            FlMessageFields fields = m_update;
+            fields.chunkOffset = m_nextOffset;
+            fields.chunkBytes = static_cast<uint16_t>(chunk);
+            if (m_nextOffset + chunk == m_end) {
+                fields.flags |= FL_FLAG_LAST_CHUNK;
+            }
+            Ptr<Packet> packet = Create<Packet>(chunk);
+            packet->AddHeader(FlUpdateHeader(fields));
+            socket->Send(packet);
+            m_nextOffset += chunk;
+            m_bytesSent += kFlMessageSize + chunk;
+        }
+    }
+
+    Address m_server;
+    uint32_t m_chunkBytes = 1000;
+    Ptr<Socket> m_socket;
+    bool m_connected = false;
+    bool m_uploading = false;
+    FlMessageFields m_update;
+    uint32_t m_begin = 0;
+    uint32_t m_end = 0;
+    uint32_t m_nextOffset = 0;
+    uint64_t m_bytesSent = 0;
+    bool m_roamedDuringUpload = false;
+    uint64_t m_lostBytes = 0; // update payload sent and then discarded
+    FlStreamParser m_parser;
+    TracedCallback<const FlMessageView &> m_messageRx;
+    Callback<bool, uint32_t> m_gate;
+    uint16_t m_broadcastPort = 0;
+    Ptr<Socket> m_broadcastSocket;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FlClientApp);
+
+// ---------------- Mode Profiles ----------------
+// How each mode shapes the packet-level update it sends.
+struct FlModeProfile {
+    FlCodec codec;
+    double updateScale; // on-air bytes relative to the raw update
+    bool dp;
+};
+
+static FlModeProfile GetModeProfile(const std::string &mode) {
+    if (mode == "AITP") {
+        return {FlCodec::Fp16, 0.5, true}; // half-precision updates with DP
+    } else if (mode == "CAIP") {
+        return {FlCodec::None, 1.0, true};
+    }
+    return {FlCodec::None, 1.0, false}; // NAP: raw updates, no DP
+}
+
+// Share of an update's value carried by the payload range [from, to), both
+// fractions of the payload. Importance-ordered uploads put the
+// largest-magnitude parameters (or the highest-priority layers) first,
+// modelled as a power law, so the first x carries x^importanceExponent; a
+// piece of a sequential upload is useless to the aggregator, so only whole
+// updates count there (callers handle the whole update).
+static double CapturedImportance(const SimulationParams &params, double from, double to) {
+    if (params.uploadOrder != "importance") {
+        return 0.0;
+    }
+    return std::pow(to, params.importanceExponent) - std::pow(from, params.importanceExponent);
+}
+
+// Header fields of the model update sent in the given round.
+static FlMessageFields MakeUpdateFields(const SimulationParams &params, const FlModeProfile &profile, uint32_t round) {
+    FlMessageFields fields;
+    fields.round = round;
+    fields.modelVersion = round - 1;
+    fields.rawBytes = params.modelBytes;
+    fields.payloadBytes = static_cast<uint32_t>(params.modelBytes * profile.updateScale);
+    fields.codec = profile.codec;
+    if (params.uploadOrder == "importance") {
+        fields.flags |= FL_FLAG_IMPORTANCE;
+    }
+    if (profile.dp) {
+        // Gaussian mechanism: sigma = sqrt(2 ln(1.25 / delta)) / epsilon
+        fields.flags |= FL_FLAG_DP;
+        fields.dpEpsilon = static_cast<float>(params.dpEpsilon);
+        fields.dpDelta = 1e-5f;
+        fields.dpNoiseMultiplier = static_cast<float>(std::sqrt(2.0 * std::log(1.25 / 1e-5)) / params.dpEpsilon);
+        fields.dpClipNorm = 1.0f;
+    }
+    return fields;
+}
+
+// ---------------- Join Schedule ----------------
+// Join time per STA. "all" reproduces the association storm of every STA
+// starting at time zero; the others spread the joins out.
+static std::vector<double> ComputeJoinTimes(const SimulationParams &params) {
+    std::vector<double> joinTimes(params.nSta, 0.0);
+    Ptr<UniformRandomVariable> u = CreateObject<UniformRandomVariable>();
+    for (uint32_t i = 0; i < params.nSta; ++i) {
+        if (params.joinSchedule == "staggered") {
+            joinTimes[i] = i * params.joinInterval;
+        } else if (params.joinSchedule == "random") {
+            joinTimes[i] = u->GetValue(0.0, params.joinWindow);
+        } else if (params.joinSchedule == "batched") {
+            joinTimes[i] = (i / params.joinBatchSize) * params.joinInterval;
+        } else {
+            NS_ABORT_MSG_IF(params.joinSchedule != "all", "Unknown join schedule " << params.joinSchedule);
+        }
+    }
+    return joinTimes;
+}
+
+// STAs that have not joined yet scan for a parked SSID that no AP serves,
+// so they stay silent until JoinBss hands them the real one.
+static const char *kParkedSsid = "fl-parked";
+
+static void JoinBss(Ptr<WifiMac> mac, Ssid ssid) {
+    mac->SetSsid(ssid);
+}
+
+// Per-window counters read and reset by TimeSeriesSampler.
+struct WindowCounters {
+    uint64_t rxBytes = 0;
+    double latencySum = 0.0;
+    uint32_t latencyCount = 0;
+    uint32_t activeClients = 0;
+};
+
+// ---------------- FL Coordinator ----------------
+// Drives FL rounds over the client apps. FL starts once flStartFraction of
+// the STAs are associated (or at flStartTimeout); each round selects the
+// associated clients and ends when all their updates arrived or at the
+// round deadline. Re-associating with a different BSSID is a handover; the
+// gap since the STA lost its previous AP is recorded. Updates cut off by
+// the deadline contribute the value of the prefix that arrived
+// (CapturedImportance).
+//
+// With flProtocol "split" a selected client instead runs splitBatches
+// mini-batches: after clientComputeTime it sends its cut-layer activations,
+// the server answers with gradients after serverComputeTime, and the
+// client's update is complete when the last gradient arrives.
+//
+// Selected clients train for trainTime times their compute factor before
+// uploading. With submodel "dropout" the AP instead hands each client the
+// largest sub-model (a fraction of the model's blocks, contiguous from a
+// random offset) that its training and upload fit in submodelBudget of the
+// deadline; upload time comes from the client's rate on its last update.
+// The update shrinks to that fraction, and at round end every block is
+// rebuilt from the completed updates that trained it.
+//
+// SetLinks gives every client one app per radio link (multi-band). An
+// update is then cut into one contiguous share per link by bandSplit:
+// "first" link only, "even", "capacity" (nominal link weights) or
+// "adaptive" (each link's rate on the client's previous update); it is
+// complete when every share has arrived.
+//
+// With clusters > 0 the AP keeps one model per cluster. Every completed
+// update contributes a clusterDim-float sketch (its population's centre
+// plus noise, population = client id mod clusterGroups); at round end the
+// AP re-clusters the round's sketches with mini-batch k-means, warm-started
+// from the previous round, and each round opens with one broadcast per
+// cluster model. Clustering wall-clock time is measured, not simulated.
+//
+// Per-client scalars live in an FlClientTable (fl_client_table.h) so the
+// per-round passes over all clients run over contiguous columns.
+class FlCoordinator {
+public:
+    FlCoordinator(const SimulationParams &params, const FlModeProfile &profile,
+                  const std::vector<Ptr<FlClientApp>> &clients, const std::vector<double> &joinTimes)
+        : m_params(params), m_profile(profile), m_clients(clients), m_joinTimes(joinTimes), m_table(clients.size()),
+          m_clientLatency(clients.size()), m_bssid(clients.size()), m_batchSent(clients.size()),
+          m_computeEvent(clients.size()), m_uploadStart(clients.size()),
+          m_blockCover(std::max<uint32_t>(1, params.submodelBlocks), 0), m_sketchRng(params.seed + params.run - 1) {
+        SetLinks({clients}, {1.0});
+        Ptr<UniformRandomVariable> u = CreateObject<UniformRandomVariable>();
+        for (double &factor : m_table.computeFactor) {
+            factor = u->GetValue(1.0, std::max(1.0, m_params.computeSpread));
+        }
+        m_blockRng = CreateObject<UniformRandomVariable>();
+        if (m_params.clusters > 0) {
+            m_kmeans = std::make_unique<MiniBatchKMeans>(m_params.clusters, m_params.clusterDim, m_params.clusterBatch,
+                                                         m_params.clusterIterations, m_params.seed);
+            std::normal_distribution<float> normal(0.0f, 1.0f);
+            m_groupCentres.resize(static_cast<size_t>(m_params.clusterGroups) * m_params.clusterDim);
+            for (float &c : m_groupCentres) {
+                c = normal(m_sketchRng);
+            }
+            m_sketches.resize(clients.size() * m_params.clusterDim);
+        }
+    }
+
+    // Server that answers split-learning activations and, with clustering,
+    // broadcasts the cluster models to downlinkPort.
+    void SetServer(Ptr<FlServerApp> server, uint16_t downlinkPort = 0) {
+        m_server = server;
+        m_downlinkPort = downlinkPort;
+    }
+
+    // links[l][i] is client i's app on link l; links[0] must be the clients
+    // passed to the constructor.
+    void SetLinks(const std::vector<std::vector<Ptr<FlClientApp>>> &links, const std::vector<double> &weights) {
+        m_links = links;
+        m_linkWeight = weights;
+        size_t parts = m_clients.size() * links.size();
+        m_partBegin.assign(parts, 0);
+        m_partEnd.assign(parts, 0);
+        m_partReceived.assign(parts, 0);
+        m_linkRate.assign(parts, -1.0);
+        std::fill(m_table.partsLeft.begin(), m_table.partsLeft.end(), 0);
+    }
+
+    void ScheduleStartTimeout() {
+        Simulator::Schedule(Seconds(m_params.flStartTimeout), &FlCoordinator::Start, this);
+    }
+
+    void OnAssociated(uint32_t client, Mac48Address bssid) {
+        double now = Simulator::Now().GetSeconds();
+        if (m_table.assocTime[client] < 0) {
+            m_table.assocTime[client] = now;
+        } else if (bssid != m_bssid[client]) {
+            ++m_table.handovers[client];
+            if (m_table.deassocTime[client] >= 0) {
+                m_handoverGap.push_back(now - m_table.deassocTime[client]);
+            }
+            m_clients[client]->OnHandover(m_params.handoverPolicy == "restart");
+        }
+        m_bssid[client] = bssid;
+        if (!m_table.associated[client]) {
+            m_table.associated[client] = true;
+            ++m_nAssociated;
+        }
+        if (!m_started && m_nAssociated >= m_params.flStartFraction * m_clients.size()) {
+            Start();
+        }
+    }
+
+    void OnDisassociated(uint32_t client) {
+        m_table.deassocTime[client] = Simulator::Now().GetSeconds();
+        if (m_table.associated[client]) {
+            m_table.associated[client] = false;
+            --m_nAssociated;
+        }
+    }
+
+    // A client that leaves mid-round abandons its update.
+    void SetAvailable(uint32_t client, bool available) {
+        m_table.available[client] = available;
+        if (!available && m_table.selected[client]) {
+            m_table.selected[client] = false;
+            StopUploads(client);
+            m_computeEvent[client].Cancel();
+            if (--m_pending == 0) {
+                m_deadline.Cancel();
+                EndRound();
+            }
+        }
+    }
+
+    WindowCounters TakeWindow() {
+        WindowCounters counters = m_window;
+        m_window = WindowCounters();
+        ++m_windowIndex;
+        return counters;
+    }
+
+    void OnChunk(const FlMessageView &msg) {
+        m_rxBytes += msg.ChunkBytes();
+        m_window.rxBytes += msg.ChunkBytes();
+        if (msg.ClientId() < m_clients.size()) {
+            m_table.rxBytes[msg.ClientId()] += msg.ChunkBytes();
+            if (m_table.lastActiveWindow[msg.ClientId()] != m_windowIndex) {
+                m_table.lastActiveWindow[msg.ClientId()] = m_windowIndex;
+                ++m_window.activeClients;
+            }
+        }
+        if (m_started) {
+            size_t bin = static_cast<size_t>((Simulator::Now().GetSeconds() - m_startTime) / m_params.goodputBin);
+            if (bin >= m_binBytes.size()) {
+                m_binBytes.resize(bin + 1, 0);
+            }
+            m_binBytes[bin] += msg.ChunkBytes();
+        }
+        uint32_t client = msg.ClientId();
+        if (msg.Round() != m_round || !m_table.selected[client]) {
+            return;
+        }
+        bool last = msg.Flags() & FL_FLAG_LAST_CHUNK;
+        if (msg.Type() == FlMessageType::ModelUpdate) {
+            size_t part = PartOf(client, msg.ChunkOffset());
+            uint32_t end = msg.ChunkOffset() + msg.ChunkBytes() - m_partBegin[part];
+            m_partReceived[part] = std::max(m_partReceived[part], end);
+            if (!last) {
+                return;
+            }
+            RecordLinkRate(client, part);
+            if (--m_table.partsLeft[client] > 0) {
+                return;
+            }
+        } else if (!last) {
+            return;
+        }
+        if (msg.Type() == FlMessageType::Activation) {
+            if (msg.ModelVersion() == m_table.batch[client]) {
+                m_computeEvent[client] = Simulator::Schedule(Seconds(m_params.serverComputeTime),
+                                                             &FlCoordinator::SendGradient, this, client);
+            }
+            return;
+        }
+        CompleteUpdate(client);
+    }
+
+    // Messages the server sent back, as seen by the client apps.
+    void OnClientMessage(const FlMessageView &msg) {
+        uint32_t client = msg.ClientId();
+        if (msg.Type() != FlMessageType::Gradient || msg.Round() != m_round || !m_table.selected[client] ||
+            msg.ModelVersion() != m_table.batch[client]) {
+            return;
+        }
+        m_batchRtt.push_back((Simulator::Now() - m_batchSent[client]).GetSeconds());
+        if (++m_table.batch[client] < m_params.splitBatches) {
+            m_computeEvent[client] = Simulator::Schedule(Seconds(m_params.clientComputeTime),
+                                                         &FlCoordinator::SendActivation, this, client);
+        } else {
+            CompleteUpdate(client);
+        }
+    }
+
+    // A cluster model broadcast by the server, as seen by client.
+    void OnClusterModel(uint32_t client, const FlMessageView &msg) {
+        if (msg.Type() != FlMessageType::GlobalModel || msg.Round() != m_round || msg.ModelVersion() != m_table.cluster[client]) {
+            return;
+        }
+        m_modelRxBytes += msg.ChunkBytes();
+        if (msg.Flags() & FL_FLAG_LAST_CHUNK) {
+            ++m_roundModelsRx.back();
+        }
+    }
+
+    PacketLevelResult Collect() const {
+        PacketLevelResult result;
+        for (size_t i = 0; i < m_clients.size(); ++i) {
+            result.assocDelay.push_back(m_table.assocTime[i] < 0 ? -1.0 : m_table.assocTime[i] - m_joinTimes[i]);
+        }
+        result.flStartTime = m_startTime;
+        result.roundStart = m_roundStartTimes;
+        result.roundLatency = m_roundLatency;
+        result.roundAvailable = m_roundAvailable;
+        result.roundSelected = m_roundSelected;
+        result.roundCompleted = m_roundCompleted;
+        result.roundPartial = m_roundPartial;
+        result.roundReceived = m_roundReceived;
+        result.roundImportance = m_roundImportance;
+        result.roundSubmodel = m_roundSubmodel;
+        result.roundCoverage = m_roundCoverage;
+        result.roundMinCover = m_roundMinCover;
+        result.rxBytes = m_rxBytes;
+        result.txBytes = m_txBytes;
+        double active = m_params.simTime - m_startTime;
+        result.goodputMbps = m_started && active > 0 ? m_rxBytes * 8.0 / active / 1e6 : 0.0;
+        result.updateLatency = m_updateLatency;
+        result.handoverGap = m_handoverGap;
+        result.batchRtt = m_batchRtt;
+        result.roundClustered = m_roundClustered;
+        result.roundModelsRx = m_roundModelsRx;
+        result.clusterPurity = m_clusterPurity;
+        result.clusterTimeMs = m_clusterTimeMs;
+        result.modelRxBytes = m_modelRxBytes;
+        result.clients.resize(m_clients.size());
+        for (size_t i = 0; i < m_clients.size(); ++i) {
+            ClientRecord &record = result.clients[i];
+            record.roundsSelected = m_table.roundsSelected[i];
+            record.updatesCompleted = m_clientLatency[i].size();
+            for (const std::vector<Ptr<FlClientApp>> &link : m_links) {
+                record.bytesSent += link[i]->GetBytesSent();
+                record.lostBytes += link[i]->GetLostBytes();
+            }
+            record.rxBytes = m_table.rxBytes[i];
+            record.goodputMbps = m_started && active > 0 ? m_table.rxBytes[i] * 8.0 / active / 1e6 : 0.0;
+            record.handovers = m_table.handovers[i];
+            record.latencyP50 = Percentile(m_clientLatency[i], 0.5);
+            record.latencyP90 = Percentile(m_clientLatency[i], 0.9);
+            record.latencyP99 = Percentile(m_clientLatency[i], 0.99);
+        }
+        // Only whole bins up to simTime; the last partial bin would bias low.
+        size_t bins = m_started ? static_cast<size_t>(active / m_params.goodputBin) : 0;
+        for (size_t i = 0; i < bins; ++i) {
+            uint64_t bytes = i < m_binBytes.size() ? m_binBytes[i] : 0;
+            result.goodputSeries.push_back(bytes * 8.0 / m_params.goodputBin / 1e6);
+        }
+        return result;
+    }
+
+private:
+    void CompleteUpdate(uint32_t client) {
+        m_table.selected[client] = false;
+        for (const std::vector<Ptr<FlClientApp>> &link : m_links) {
+            link[client]->FinishUpload();
+        }
+        double latency = (Simulator::Now() - m_roundStart).GetSeconds();
+        m_updateLatency.push_back(latency);
+        m_clientLatency[client].push_back(latency);
+        if (m_params.flProtocol == "fedavg") {
+            m_table.rate[client] = m_table.payload[client] / std::max(1e-6, (Simulator::Now() - m_uploadStart[client]).GetSeconds());
+            for (uint32_t b = 0; b < SubmodelBlocks(client); ++b) {
+                ++m_blockCover[(m_table.blockStart[client] + b) % m_blockCover.size()];
+            }
+        }
+        if (m_kmeans) {
+            RecordSketch(client);
+        }
+        m_window.latencySum += latency;
+        ++m_window.latencyCount;
+        ++m_completed;
+        if (--m_pending == 0) {
+            m_deadline.Cancel();
+            EndRound();
+        }
+    }
+
+    void Start() {
+        if (m_started) {
+            return;
+        }
+        m_started = true;
+        m_startTime = Simulator::Now().GetSeconds();
+        NS_LOG_INFO("FL start at " << m_startTime << "s with " << m_nAssociated << " associated STAs");
+        StartRound();
+    }
+
+    void StartRound() {
+        ++m_round;
+        m_roundStart = Simulator::Now();
+        m_completed = 0;
+        m_pending = 0;
+        std::fill(m_blockCover.begin(), m_blockCover.end(), 0);
+
+        FlMessageFields fields = MakeUpdateFields(m_params, m_profile, m_round);
+        m_roundFields = fields;
+        if (m_kmeans) {
+            BroadcastClusterModels();
+        }
+
+        uint32_t available = m_table.Select();
+        for (uint32_t i = 0; i < m_clients.size(); ++i) {
+            if (m_table.selected[i]) {
+                if (m_params.flProtocol == "split") {
+                    m_table.batch[i] = 0;
+                    m_computeEvent[i] = Simulator::Schedule(Seconds(m_params.clientComputeTime),
+                                                            &FlCoordinator::SendActivation, this, i);
+                } else {
+                    AssignSubmodel(i);
+                    double train = m_params.trainTime * m_table.computeFactor[i] * m_table.fraction[i];
+                    m_computeEvent[i] = Simulator::Schedule(Seconds(train), &FlCoordinator::SendUpdate, this, i);
+                }
+            }
+        }
+        m_pending = m_table.CountSelected();
+        double fractions = m_params.flProtocol == "split" ? 0.0 : m_table.SumSelected(m_table.fraction);
+        m_roundSubmodel.push_back(m_pending > 0 ? fractions / m_pending : 0.0);
+        m_roundStartTimes.push_back(m_roundStart.GetSeconds());
+        m_roundAvailable.push_back(available);
+        m_roundSelected.push_back(m_pending);
+        m_deadline = Simulator::Schedule(Seconds(m_params.roundDeadline), &FlCoordinator::EndRound, this);
+    }
+
+    void EndRound() {
+        m_roundLatency.push_back((Simulator::Now() - m_roundStart).GetSeconds());
+        m_roundCompleted.push_back(m_completed);
+        uint32_t partial = 0;
+        double received = m_completed;
+        double importance = m_completed;
+        for (uint32_t i = 0; i < m_clients.size(); ++i) {
+            if (m_table.selected[i]) {
+                uint32_t bytes = ReceivedBytes(i);
+                double fraction = m_table.payload[i] > 0 ? static_cast<double>(bytes) / m_table.payload[i] : 0.0;
+                if (m_params.flProtocol == "fedavg" && m_uploadStart[i] >= m_roundStart) {
+                    // Rate seen so far; a client with nothing through drops to the smallest sub-model.
+                    m_table.rate[i] = bytes / (Simulator::Now() - m_uploadStart[i]).GetSeconds();
+                }
+                double captured = CapturedValue(i, bytes);
+                partial += captured > 0.0;
+                received += fraction;
+                importance += captured;
+                StopUploads(i);
+                m_computeEvent[i].Cancel();
+                m_table.selected[i] = false;
+            }
+        }
+        uint32_t selected = m_roundSelected.back();
+        m_roundPartial.push_back(partial);
+        m_roundReceived.push_back(selected > 0 ? received / selected : 0.0);
+        m_roundImportance.push_back(selected > 0 ? importance / selected : 0.0);
+        uint32_t covered = 0;
+        for (uint32_t n : m_blockCover) {
+            covered += n > 0;
+        }
+        m_roundCoverage.push_back(static_cast<double>(covered) / m_blockCover.size());
+        m_roundMinCover.push_back(*std::min_element(m_blockCover.begin(), m_blockCover.end()));
+        if (m_kmeans) {
+            Recluster();
+        }
+        StartRound();
+    }
+
+    // Federated dropout sizing: the largest fraction f with
+    // f * (trainTime * factor + payload / rate) within the client's budget.
+    void AssignSubmodel(uint32_t client) {
+        double fraction = 1.0;
+        if (m_params.submodel == "dropout") {
+            double upload = m_table.rate[client] < 0 ? 0.0
+                            : m_table.rate[client] > 0 ? m_roundFields.payloadBytes / m_table.rate[client]
+                                                 : std::numeric_limits<double>::infinity();
+            double cost = m_params.trainTime * m_table.computeFactor[client] + upload;
+            double budget = m_params.submodelBudget * m_params.roundDeadline;
+            fraction = cost > 0 ? std::min(1.0, std::max(m_params.submodelMin, budget / cost)) : 1.0;
+        }
+        m_table.fraction[client] = fraction;
+        m_table.payload[client] = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(m_roundFields.payloadBytes * fraction)));
+        m_table.blockStart[client] = m_blockRng->GetInteger(0, m_blockCover.size() - 1);
+    }
+
+    uint32_t SubmodelBlocks(uint32_t client) const {
+        return static_cast<uint32_t>(std::ceil(m_table.fraction[client] * m_blockCover.size()));
+    }
+
+    void SendUpdate(uint32_t client) {
+        FlMessageFields fields = m_roundFields;
+        fields.clientId = client;
+        fields.rawBytes = static_cast<uint32_t>(std::lround(m_roundFields.rawBytes * m_table.fraction[client]));
+        fields.payloadBytes = m_table.payload[client];
+        m_uploadStart[client] = Simulator::Now();
+        std::vector<double> shares = LinkShares(client);
+        size_t links = m_links.size();
+        uint32_t begin = 0;
+        m_table.partsLeft[client] = 0;
+        for (size_t l = 0; l < links; ++l) {
+            size_t part = client * links + l;
+            uint32_t end = l + 1 == links ? fields.payloadBytes
+                                          : std::min(fields.payloadBytes,
+                                                     begin + static_cast<uint32_t>(std::lround(fields.payloadBytes * shares[l])));
+            m_partBegin[part] = begin;
+            m_partEnd[part] = end;
+            m_partReceived[part] = 0;
+            if (end > begin) {
+                m_links[l][client]->StartUpload(fields, begin, end);
+                ++m_table.partsLeft[client];
+            }
+            begin = end;
+        }
+    }
+
+    // Share of the client's update per link, summing to 1.
+    std::vector<double> LinkShares(uint32_t client) const {
+        size_t links = m_links.size();
+        std::vector<double> weights(links, 0.0);
+        weights[0] = 1.0;
+        if (m_params.bandSplit == "even") {
+            weights.assign(links, 1.0);
+        } else if (m_params.bandSplit == "capacity") {
+            weights = m_linkWeight;
+        } else if (m_params.bandSplit == "adaptive") {
+            weights = m_linkWeight;
+            bool measured = true;
+            for (size_t l = 0; l < links; ++l) {
+                measured = measured && m_linkRate[client * links + l] > 0;
+            }
+            if (measured) {
+                std::copy_n(&m_linkRate[client * links], links, weights.begin());
+            }
+        }
+        double total = 0.0;
+        for (double w : weights) {
+            total += w;
+        }
+        for (double &w : weights) {
+            w /= total;
+        }
+        return weights;
+    }
+
+    size_t PartOf(uint32_t client, uint32_t offset) const {
+        size_t links = m_links.size();
+        for (size_t l = 0; l + 1 < links; ++l) {
+            if (offset < m_partEnd[client * links + l]) {
+                return client * links + l;
+            }
+        }
+        return client * links + links - 1;
+    }
+
+    // Update payload received this round over all links.
+    uint32_t ReceivedBytes(uint32_t client) const {
+        size_t links = m_links.size();
+        uint32_t received = 0;
+        for (size_t l = 0; l < links; ++l) {
+            received += m_partReceived[client * links + l];
+        }
+        return received;
+    }
+
+    // Value of the received bytes of a client's update. Each link sends its
+    // contiguous share of the payload from the front, so it contributes the
+    // slice of the importance curve its received prefix covers.
+    double CapturedValue(uint32_t client, uint32_t received) const {
+        double payload = m_table.payload[client];
+        if (payload == 0) {
+            return 0.0;
+        }
+        if (received >= payload) {
+            return 1.0;
+        }
+        size_t links = m_links.size();
+        double captured = 0.0;
+        for (size_t l = 0; l < links; ++l) {
+            size_t part = client * links + l;
+            captured += CapturedImportance(m_params, m_partBegin[part] / payload,
+                                           (m_partBegin[part] + m_partReceived[part]) / payload);
+        }
+        return captured;
+    }
+
+    // Smoothed rate of a link, from the time its share took to arrive.
+    void RecordLinkRate(uint32_t client, size_t part) {
+        double elapsed = (Simulator::Now() - m_uploadStart[client]).GetSeconds();
+        double rate = (m_partEnd[part] - m_partBegin[part]) / std::max(1e-6, elapsed);
+        m_linkRate[part] = m_linkRate[part] < 0 ? rate : 0.5 * (m_linkRate[part] + rate);
+    }
+
+    void StopUploads(uint32_t client) {
+        for (const std::vector<Ptr<FlClientApp>> &link : m_links) {
+            link[client]->StopUpload();
+        }
+    }
+
+    void RecordSketch(uint32_t client) {
+        std::normal_distribution<float> normal(0.0f, static_cast<float>(m_params.clusterNoise));
+        const float *centre = &m_groupCentres[(client % m_params.clusterGroups) * m_params.clusterDim];
+        float *row = &m_sketches[static_cast<size_t>(client) * m_params.clusterDim];
+        for (uint32_t d = 0; d < m_params.clusterDim; ++d) {
+            row[d] = centre[d] + normal(m_sketchRng);
+        }
+        m_roundClients.push_back(client);
+    }
+
+    // The first fit waits for at least `clusters` sketches so that every
+    // cluster gets a seed; until then all clients share cluster 0.
+    void Recluster() {
+        size_t n = m_roundClients.size();
+        size_t dim = m_params.clusterDim;
+        if (n == 0 || (m_kmeans->Clusters() == 0 && n < m_params.clusters)) {
+            m_roundClustered.push_back(0);
+            m_clusterPurity.push_back(0.0);
+            m_clusterTimeMs.push_back(0.0);
+            m_roundClients.clear();
+            return;
+        }
+        std::vector<float> points(n * dim);
+        std::vector<uint32_t> groups(n);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t client = m_roundClients[i];
+            std::copy_n(&m_sketches[client * dim], dim, &points[i * dim]);
+            groups[i] = client % m_params.clusterGroups;
+        }
+        std::vector<uint32_t> labels(n);
+        auto start = std::chrono::steady_clock::now();
+        m_kmeans->Fit(points.data(), n);
+        m_kmeans->Assign(points.data(), n, labels.data());
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        for (size_t i = 0; i < n; ++i) {
+            m_table.cluster[m_roundClients[i]] = labels[i];
+        }
+        m_roundClustered.push_back(n);
+        m_clusterPurity.push_back(ClusterPurity(labels, groups, m_kmeans->Clusters(), m_params.clusterGroups));
+        m_clusterTimeMs.push_back(std::chrono::duration<double, std::milli>(elapsed).count());
+        m_roundClients.clear();
+    }
+
+    // One downlink per cluster model, shaped like the round's update.
+    void BroadcastClusterModels() {
+        m_roundModelsRx.push_back(0);
+        size_t models = std::max<size_t>(1, m_kmeans->Clusters());
+        for (uint32_t c = 0; c < models; ++c) {
+            FlMessageFields fields = m_roundFields;
+            fields.type = FlMessageType::GlobalModel;
+            fields.clientId = 0;
+            fields.modelVersion = c;
+            fields.flags &= ~FL_FLAG_DP;
+            m_server->Broadcast(fields, m_params.chunkBytes, m_downlinkPort, m_params.downlinkRate);
+            m_txBytes += fields.payloadBytes;
+        }
+    }
+
+    // Split learning: activations (client to server) and gradients (server
+    // to client) are sized like the model update, scaled by the mode's codec.
+    void SendActivation(uint32_t client) {
+        FlMessageFields fields = m_roundFields;
+        fields.type = FlMessageType::Activation;
+        fields.clientId = client;
+        fields.modelVersion = m_table.batch[client];
+        fields.rawBytes = m_params.activationBytes;
+        fields.payloadBytes = static_cast<uint32_t>(m_params.activationBytes * m_profile.updateScale);
+        m_batchSent[client] = Simulator::Now();
+        m_clients[client]->StartUpload(fields);
+    }
+
+    void SendGradient(uint32_t client) {
+        FlMessageFields fields = m_roundFields;
+        fields.type = FlMessageType::Gradient;
+        fields.clientId = client;
+        fields.modelVersion = m_table.batch[client];
+        fields.rawBytes = m_params.gradientBytes;
+        fields.payloadBytes = static_cast<uint32_t>(m_params.gradientBytes * m_profile.updateScale);
+        if (m_server->SendToClient(client, fields, m_params.chunkBytes)) {
+            m_txBytes += fields.payloadBytes;
+        }
+    }
+
+    const SimulationParams &m_params;
+    FlModeProfile m_profile;
+    std::vector<Ptr<FlClientApp>> m_clients;
+    std::vector<double> m_joinTimes;
+    FlClientTable m_table;
+    uint32_t m_nAssociated = 0;
+    bool m_started = false;
+    double m_startTime = 0.0;
+    uint32_t m_round = 0;
+    Time m_roundStart;
+    uint32_t m_completed = 0;
+    uint32_t m_pending = 0;
+    EventId m_deadline;
+    std::vector<double> m_roundStartTimes;
+    std::vector<uint32_t> m_roundAvailable;
+    std::vector<uint32_t> m_roundSelected;
+    std::vector<double> m_roundLatency;
+    std::vector<uint32_t> m_roundCompleted;
+    std::vector<std::vector<double>> m_clientLatency;
+    std::vector<double> m_updateLatency;
+    std::vector<uint64_t> m_binBytes;
+    uint64_t m_rxBytes = 0;
+    WindowCounters m_window;
+    uint32_t m_windowIndex = 0;
+    std::vector<Mac48Address> m_bssid;
+    std::vector<double> m_handoverGap;
+    Ptr<FlServerApp> m_server;
+    FlMessageFields m_roundFields;
+    std::vector<Time> m_batchSent;
+    std::vector<EventId> m_computeEvent;
+    std::vector<double> m_batchRtt;
+    uint64_t m_txBytes = 0;
+    std::vector<std::vector<Ptr<FlClientApp>>> m_links; // per link, per client
+    std::vector<double> m_linkWeight;     // nominal capacity per link
+    std::vector<uint32_t> m_partBegin;    // per client and link: share of this round's update
+    std::vector<uint32_t> m_partEnd;
+    std::vector<uint32_t> m_partReceived; // contiguous bytes of the share received
+    std::vector<double> m_linkRate;       // B/s on the last update; -1 unknown
+    std::vector<uint32_t> m_roundPartial;
+    std::vector<double> m_roundReceived;
+    std::vector<double> m_roundImportance;
+    std::vector<Time> m_uploadStart;
+    std::vector<uint32_t> m_blockCover;   // completed updates per model block this round
+    Ptr<UniformRandomVariable> m_blockRng;
+    std::vector<double> m_roundSubmodel;
+    std::vector<double> m_roundCoverage;
+    std::vector<double> m_roundMinCover;
+    uint16_t m_downlinkPort = 0;
+    std::mt19937 m_sketchRng;
+    std::unique_ptr<MiniBatchKMeans> m_kmeans; // null unless clustered
+    std::vector<float> m_groupCentres;         // clusterGroups x clusterDim
+    std::vector<float> m_sketches;             // latest sketch per client
+    std::vector<uint32_t> m_roundClients;      // sketches recorded this round
+    std::vector<uint32_t> m_roundClustered;
+    std::vector<uint32_t> m_roundModelsRx;
+    std::vector<double> m_clusterPurity;
+    std::vector<double> m_clusterTimeMs;
+    uint64_t m_modelRxBytes = 0;
+};
+
+// Cluster-model broadcasts reach every client app; bind the receiver.
+static void ClusterModelRx(FlCoordinator *coordinator, uint32_t client, const FlMessageView &msg) {
+    coordinator->OnClusterModel(client, msg);
+}
+
+static void CountFinalDataFailure(uint32_t *drops, Mac48Address address) {
+    ++*drops;
+}
+
+static void CountMacTxDrop(uint32_t *drops, Ptr<const Packet> packet) {
+    ++*drops;
+}
+
+static void CountStationEvent(uint64_t *count, Mac48Address address) {
+    ++*count;
+}
+
+static void CountTxBegin(uint64_t *count, Ptr<const Packet> packet, double txPowerW) {
+    ++*count;
+}
+
+static void CountRxEnd(uint64_t *count, Ptr<const Packet> packet) {
+    ++*count;
+}
+
+static void CountRxDrop(uint64_t *count, Ptr<const Packet> packet, WifiPhyRxfailureReason reason) {
+    ++*count;
+}
+
+struct ArpCounter {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+};
+
+// MacTx sees packets with the LLC/SNAP header WifiNetDevice adds.
+static void CountArp(ArpCounter *counter, Ptr<const Packet> packet) {
+    LlcSnapHeader llc;
+    if (packet->GetSize() >= llc.GetSerializedSize() && packet->PeekHeader(llc) &&
+        llc.GetType() == ArpL3Protocol::PROT_NUMBER) {
+        ++counter->frames;
+        counter->bytes += packet->GetSize();
+    }
+}
+
+static void ConnectArpCounter(const NetDeviceContainer &devices, ArpCounter &counter) {
+    for (uint32_t i = 0; i < devices.GetN(); ++i) {
+        Ptr<WifiMac> mac = DynamicCast<WifiNetDevice>(devices.Get(i))->GetMac();
+        mac->TraceConnectWithoutContext("MacTx", MakeBoundCallback(&CountArp, &counter));
+    }
+}
+
+// RTS/CTS threshold for mode from params.rtsCts, a comma list of policies
+// ("off", "always" or a byte threshold), each optionally "MODE:"-prefixed.
+// A mode-specific entry wins over a plain one.
+static uint32_t RtsCtsThreshold(const SimulationParams &params, const std::string &mode) {
+    std::string policy = "off";
+    std::stringstream list(params.rtsCts);
+    std::string item;
+    bool specific = false;
+    while (std::getline(list, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) {
+            policy = specific ? policy : item;
+        } else if (item.substr(0, colon) == mode) {
+            policy = item.substr(colon + 1);
+            specific = true;
+        }
+    }
+    if (policy == "off") {
+        return 65535;
+    } else if (policy == "always") {
+        return 0;
+    }
+    char *end = nullptr;
+    unsigned long bytes = std::strtoul(policy.c_str(), &end, 10);
+    NS_ABORT_MSG_IF(policy.empty() || *end != '\0' || bytes > 65535, "Bad RTS/CTS policy " << policy);
+    return static_cast<uint32_t>(bytes);
+}
+
+static void AccumulateTxTime(double *airtime, Time start, Time duration, WifiPhyState state) {
+    if (state == WifiPhyState::TX) {
+        *airtime += duration.GetSeconds();
+    }
+}
+
+static void AccumulateBusyTime(double *busy, Time start, Time duration, WifiPhyState state) {
+    if (state == WifiPhyState::TX || state == WifiPhyState::RX || state == WifiPhyState::CCA_BUSY) {
+        *busy += duration.GetSeconds();
+    }
+}
+
+// Airtime per device: the PHY state helper reports every TX period.
+static void ConnectAirtime(const NetDeviceContainer &devices, std::vector<double> &airtime) {
+    airtime.assign(devices.GetN(), 0.0);
+    for (uint32_t i = 0; i < devices.GetN(); ++i) {
+        Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(devices.Get(i))->GetPhy();
+        phy->GetState()->TraceConnectWithoutContext("State", MakeBoundCallback(&AccumulateTxTime, &airtime[i]));
+    }
+}
+
+// Channel busy time per device as its PHY senses it: transmitting,
+// receiving or CCA busy.
+static void ConnectBusyTime(const NetDeviceContainer &devices, std::vector<double> &busy) {
+    busy.assign(devices.GetN(), 0.0);
+    for (uint32_t i = 0; i < devices.GetN(); ++i) {
+        Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(devices.Get(i))->GetPhy();
+        phy->GetState()->TraceConnectWithoutContext("State", MakeBoundCallback(&AccumulateBusyTime, &busy[i]));
+    }
+}
+
+static double Sum(const std::vector<double> &values) {
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    return sum;
+}
+
+// ---------------- FL Jobs ----------------
+// Independent FL jobs sharing the BSS, from params.jobs: comma-separated
+// "name:modelBytes:roundDeadline:clientFraction:weight" entries. Each job has
+// its own server port, client apps and FlCoordinator; roundDeadline plays
+// the role of params.roundDeadline for that job, so its next round starts
+// as soon as the previous one ends. Its clients are the
+// next clientFraction * nSta STAs after the previous job's slice, wrapping
+// around, so fractions summing above 1 make jobs share STAs. Without
+// params.jobs there is one job over all STAs.
+struct FlJobSpec {
+    std::string name;
+    uint32_t modelBytes = 0;
+    double roundDeadline = 0.0;
+    double clientFraction = 1.0;
+    double weight = 1.0;
+};
+
+static std::vector<FlJobSpec> ParseJobs(const SimulationParams &params) {
+    if (params.jobs.empty()) {
+        return {{"default", params.modelBytes, params.roundDeadline, 1.0, 1.0}};
+    }
+    std::vector<FlJobSpec> specs;
+    std::istringstream entries(params.jobs);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        std::istringstream fields(entry);
+        FlJobSpec spec;
+        char sep[3] = {};
+        std::getline(fields, spec.name, ':');
+        fields >> spec.modelBytes >> sep[0] >> spec.roundDeadline >> sep[1] >> spec.clientFraction >> sep[2] >>
+            spec.weight;
+        NS_ABORT_MSG_IF(fields.fail() || spec.name.empty() || sep[0] != ':' || sep[1] != ':' || sep[2] != ':' ||
+                            spec.weight <= 0,
+                        "Bad job spec " << entry);
+        specs.push_back(spec);
+    }
+    return specs;
+}
+
+// Weighted deficit round robin over jobs, run at the AP. Every quantum the
+// jobs that asked to send share quantum seconds of airtime by weight; a
+// client may queue a chunk only while its job's deficit covers the chunk's
+// airtime. A chunk costs its bytes times the STA's measured airtime per
+// admitted byte, so stations on slow links pay more. Grants are modelled
+// out of band, as if carried by trigger frames.
+class JobScheduler {
+public:
+    JobScheduler(const std::vector<double> &weights, double quantum, const std::vector<double> &staAirtime)
+        : m_weights(weights), m_quantum(quantum), m_staAirtime(staAirtime), m_jobs(weights.size()),
+          m_staBytes(staAirtime.size(), 0) {}
+
+    void AddClient(uint32_t job, uint32_t sta, FlClientApp *app) {
+        m_jobs[job].stas.push_back(sta);
+        m_jobs[job].apps.push_back(app);
+        m_jobs[job].waiting.push_back(false);
+    }
+
+    void Start() {
+        m_event = Simulator::Schedule(Seconds(m_quantum), &JobScheduler::Replenish, this);
+    }
+
+    bool Request(uint32_t job, uint32_t client, uint32_t bytes) {
+        JobState &state = m_jobs[job];
+        uint32_t sta = state.stas[client];
+        double cost = bytes * AirtimePerByte(sta);
+        state.active = true;
+        if (state.deficit < cost) {
+            state.largestRefused = std::max(state.largestRefused, cost);
+            if (!state.waiting[client]) {
+                state.waiting[client] = true;
+                state.queue.push_back(client);
+            }
+            return false;
+        }
+        state.deficit -= cost;
+        state.granted += cost;
+        m_staBytes[sta] += bytes;
+        return true;
+    }
+
+    double GetGranted(uint32_t job) const { return m_jobs[job].granted; }
+
+private:
+    struct JobState {
+        std::vector<uint32_t> stas;
+        std::vector<FlClientApp *> apps;
+        std::vector<bool> waiting;
+        std::vector<uint32_t> queue; // refused clients in arrival order
+        double deficit = 0.0;        // s
+        double granted = 0.0;        // s
+        bool active = false;         // requested during the last quantum
+        double largestRefused = 0.0; // costliest chunk refused during the last quantum (s)
+    };
+
+    double AirtimePerByte(uint32_t sta) const {
+        // Until a STA has a few frames on air, assume 50 Mb/s.
+        if (m_staBytes[sta] < 16384 || m_staAirtime[sta] <= 0) {
+            return 8.0 / 50e6;
+        }
+        return m_staAirtime[sta] / m_staBytes[sta];
+    }
+
+    void Replenish() {
+        double weightSum = 0.0;
+        for (size_t j = 0; j < m_jobs.size(); ++j) {
+            weightSum += m_jobs[j].active ? m_weights[j] : 0.0;
+        }
+        for (size_t j = 0; j < m_jobs.size(); ++j) {
+            JobState &state = m_jobs[j];
+            // An idle job loses its deficit; a busy one keeps up to two quanta,
+            // or enough for its costliest waiting chunk so a slow STA cannot starve.
+            double cap = std::max(2 * m_quantum, state.largestRefused);
+            state.deficit = state.active ? std::min(state.deficit + m_quantum * m_weights[j] / weightSum, cap) : 0.0;
+            state.active = false;
+            state.largestRefused = 0.0;
+        }
+        for (JobState &state : m_jobs) {
+            std::vector<uint32_t> queue;
+            queue.swap(state.queue);
+            for (uint32_t client : queue) {
+                state.waiting[client] = false;
+                state.apps[client]->Resume();
+            }
+        }
+        m_event = Simulator::Schedule(Seconds(m_quantum), &JobScheduler::Replenish, this);
+    }
+
+    std::vector<double> m_weights;
+    double m_quantum;
+    const std::vector<double> &m_staAirtime;
+    std::vector<JobState> m_jobs;
+    std::vector<uint64_t> m_staBytes;
+    EventId m_event;
+};
+
+static bool JobGate(JobScheduler *scheduler, uint32_t job, uint32_t client, uint32_t bytes) {
+    return scheduler->Request(job, client, bytes);
+}
+
+struct FlJob {
+    FlJobSpec spec;
+    SimulationParams params;       // run params with the job's model size and round period
+    std::vector<uint32_t> stas;    // client index -> STA
+    std::vector<int32_t> clientOf; // STA -> client index, -1 if not in the job
+    Ptr<FlServerApp> server;
+    std::vector<Ptr<FlClientApp>> clients;
+    std::unique_ptr<FlCoordinator> coordinator;
+};
+
+typedef std::vector<std::unique_ptr<FlJob>> FlJobList;
+
+// STA events fan out to every job the STA belongs to.
+static void JobsAssociated(FlJobList *jobs, uint32_t sta, Mac48Address bssid) {
+    for (auto &job : *jobs) {
+        if (job->clientOf[sta] >= 0) {
+            job->coordinator->OnAssociated(job->clientOf[sta], bssid);
+        }
+    }
+}
+
+static void JobsDisassociated(FlJobList *jobs, uint32_t sta, Mac48Address bssid) {
+    for (auto &job : *jobs) {
+        if (job->clientOf[sta] >= 0) {
+            job->coordinator->OnDisassociated(job->clientOf[sta]);
+        }
+    }
+}
+
+static void JobsSetAvailable(FlJobList *jobs, uint32_t sta, bool available) {
+    for (auto &job : *jobs) {
+        if (job->clientOf[sta] >= 0) {
+            job->coordinator->SetAvailable(job->clientOf[sta], available);
+        }
+    }
+}
+
+static WindowCounters JobsTakeWindow(FlJobList *jobs) {
+    WindowCounters total;
+    for (auto &job : *jobs) {
+        WindowCounters counters = job->coordinator->TakeWindow();
+        total.rxBytes += counters.rxBytes;
+        total.latencySum += counters.latencySum;
+        total.latencyCount += counters.latencyCount;
+        total.activeClients += counters.activeClients;
+    }
+    return total;
+}
+
+// ---------------- Gossip FL ----------------
+// Decentralised FL over ad-hoc wifi. Each gossip round every available
+// station sends its model to gossipFanout neighbours chosen by a
+// PeerSelector, and a receiver averages each arriving model into its own.
+// Models are scalars standing in for the parameter vector, so their spread
+// across stations shows how far gossip is from consensus.
+class PeerSelector {
+public:
+    virtual ~PeerSelector() = default;
+    // Up to fanout peers for node out of candidates (ascending ids).
+    virtual std::vector<uint32_t> Select(uint32_t node, const std::vector<uint32_t> &candidates,
+                                         uint32_t fanout) = 0;
+};
+
+class RandomPeerSelector : public PeerSelector {
+public:
+    RandomPeerSelector() : m_uniform(CreateObject<UniformRandomVariable>()) {}
+
+    std::vector<uint32_t> Select(uint32_t node, const std::vector<uint32_t> &candidates,
+                                 uint32_t fanout) override {
+        std::vector<uint32_t> peers = candidates;
+        uint32_t n = std::min<uint32_t>(fanout, peers.size());
+        for (uint32_t k = 0; k < n; ++k) {
+            std::swap(peers[k], peers[m_uniform->GetInteger(k, peers.size() - 1)]);
+        }
+        peers.resize(n);
+        return peers;
+    }
+
+private:
+    Ptr<UniformRandomVariable> m_uniform;
+};
+
+class NearestPeerSelector : public PeerSelector {
+public:
+    explicit NearestPeerSelector(const NodeContainer &nodes) : m_nodes(nodes) {}
+
+    std::vector<uint32_t> Select(uint32_t node, const std::vector<uint32_t> &candidates,
+                                 uint32_t fanout) override {
+        Ptr<MobilityModel> self = m_nodes.Get(node)->GetObject<MobilityModel>();
+        std::vector<std::pair<double, uint32_t>> byDistance;
+        for (uint32_t peer : candidates) {
+            byDistance.push_back({self->GetDistanceFrom(m_nodes.Get(peer)->GetObject<MobilityModel>()), peer});
+        }
+        uint32_t n = std::min<uint32_t>(fanout, byDistance.size());
+        std::partial_sort(byDistance.begin(), byDistance.begin() + n, byDistance.end());
+        std::vector<uint32_t> peers;
+        for (uint32_t k = 0; k < n; ++k) {
+            peers.push_back(byDistance[k].second);
+        }
+        return peers;
+    }
+
+private:
+    NodeContainer m_nodes;
+};
+
+// Walks the candidates in id order, carrying on after the last peer used.
+class RoundRobinPeerSelector : public PeerSelector {
+public:
+    explicit RoundRobinPeerSelector(uint32_t nodes) : m_next(nodes, 0) {}
+
+    std::vector<uint32_t> Select(uint32_t node, const std::vector<uint32_t> &candidates,
+                                 uint32_t fanout) override {
+        std::vector<uint32_t> peers;
+        uint32_t n = std::min<uint32_t>(fanout, candidates.size());
+        size_t k = std::lower_bound(candidates.begin(), candidates.end(), m_next[node]) - candidates.begin();
+        for (uint32_t i = 0; i < n; ++i, ++k) {
+            peers.push_back(candidates[k % candidates.size()]);
+        }
+        if (n > 0) {
+            m_next[node] = peers.back() + 1;
+        }
+        return peers;
+    }
+
+private:
+    std::vector<uint32_t> m_next;
+};
+
+static std::unique_ptr<PeerSelector> CreatePeerSelector(const std::string &name, const NodeContainer &nodes) {
+    if (name == "random") {
+        return std::make_unique<RandomPeerSelector>();
+    } else if (name == "nearest") {
+        return std::make_unique<NearestPeerSelector>(nodes);
+    }
+    NS_ABORT_MSG_IF(name != "roundrobin", "Unknown gossip peer selector " << name);
+    return std::make_unique<RoundRobinPeerSelector>(nodes.GetN());
+}
+
+// Runs gossip rounds of roundDeadline seconds. Transfers use one
+// FlClientApp per directed link, created on first use; a round ends early
+// once every exchange it launched has arrived. Per-station state lives in
+// an FlClientTable like the FL coordinator's; roundsSelected counts the
+// exchanges a station launched.
+class GossipCoordinator {
+public:
+    GossipCoordinator(const SimulationParams &params, const FlModeProfile &profile, const NodeContainer &nodes,
+                      const std::vector<Address> &servers, PeerSelector *selector)
+        : m_params(params), m_profile(profile), m_nodes(nodes), m_servers(servers), m_selector(selector),
+          m_table(nodes.GetN()), m_clientLatency(nodes.GetN()) {
+        Ptr<UniformRandomVariable> u = CreateObject<UniformRandomVariable>();
+        for (uint32_t i = 0; i < nodes.GetN(); ++i) {
+            m_model.push_back(u->GetValue());
+        }
+    }
+
+    void Start() {
+        Simulator::Schedule(Seconds(0), &GossipCoordinator::StartRound, this);
+    }
+
+    // A station that leaves cancels the exchanges it sends or awaits.
+    void SetAvailable(uint32_t node, bool available) {
+        m_table.available[node] = available;
+        if (available) {
+            return;
+        }
+        bool cancelled = false;
+        for (auto it = m_outstanding.begin(); it != m_outstanding.end();) {
+            uint32_t from = static_cast<uint32_t>(it->first >> 32);
+            uint32_t to = static_cast<uint32_t>(it->first);
+            if (from == node || to == node) {
+                m_links[it->first]->StopUpload();
+                it = m_outstanding.erase(it);
+                cancelled = true;
+            } else {
+                ++it;
+            }
+        }
+        if (cancelled && m_outstanding.empty()) {
+            m_deadline.Cancel();
+            EndRound();
+        }
+    }
+
+    WindowCounters TakeWindow() {
+        WindowCounters counters = m_window;
+        m_window = WindowCounters();
+        ++m_windowIndex;
+        return counters;
+    }
+
+    void OnChunk(uint32_t receiver, const FlMessageView &msg) {
+        uint32_t sender = msg.ClientId();
+        m_rxBytes += msg.ChunkBytes();
+        m_window.rxBytes += msg.ChunkBytes();
+        if (sender < m_nodes.GetN()) {
+            m_table.rxBytes[sender] += msg.ChunkBytes();
+            if (m_table.lastActiveWindow[sender] != m_windowIndex) {
+                m_table.lastActiveWindow[sender] = m_windowIndex;
+                ++m_window.activeClients;
+            }
+        }
+        size_t bin = static_cast<size_t>(Simulator::Now().GetSeconds() / m_params.goodputBin);
+        if (bin >= m_binBytes.size()) {
+            m_binBytes.resize(bin + 1, 0);
+        }
+        m_binBytes[bin] += msg.ChunkBytes();
+        if (msg.Round() != m_round || !(msg.Flags() & FL_FLAG_LAST_CHUNK)) {
+            return;
+        }
+        auto it = m_outstanding.find(LinkKey(sender, receiver));
+        if (it == m_outstanding.end()) {
+            return;
+        }
+        m_model[receiver] = 0.5 * (m_model[receiver] + it->second);
+        m_outstanding.erase(it);
+        double latency = (Simulator::Now() - m_roundStart).GetSeconds();
+        m_updateLatency.push_back(latency);
+        m_clientLatency[sender].push_back(latency);
+        m_window.latencySum += latency;
+        ++m_window.latencyCount;
+        ++m_completed;
+        if (m_outstanding.empty()) {
+            m_deadline.Cancel();
+            EndRound();
+        }
+    }
+
+    PacketLevelResult Collect() const {
+        PacketLevelResult result;
+        result.assocDelay.assign(m_nodes.GetN(), 0.0); // no association in ad-hoc mode
+        result.roundStart = m_roundStartTimes;
+        result.roundLatency = m_roundLatency;
+        result.roundAvailable = m_roundAvailable;
+        result.roundSelected = m_roundSelected;
+        result.roundCompleted = m_roundCompleted;
+        result.roundSpread = m_roundSpread;
+        result.rxBytes = m_rxBytes;
+        result.goodputMbps = m_rxBytes * 8.0 / m_params.simTime / 1e6;
+        result.updateLatency = m_updateLatency;
+        result.clients.resize(m_nodes.GetN());
+        for (uint32_t i = 0; i < m_nodes.GetN(); ++i) {
+            ClientRecord &record = result.clients[i];
+            record.roundsSelected = m_table.roundsSelected[i];
+            record.updatesCompleted = m_clientLatency[i].size();
+            record.rxBytes = m_table.rxBytes[i];
+            record.goodputMbps = m_table.rxBytes[i] * 8.0 / m_params.simTime / 1e6;
+            record.latencyP50 = Percentile(m_clientLatency[i], 0.5);
+            record.latencyP90 = Percentile(m_clientLatency[i], 0.9);
+            record.latencyP99 = Percentile(m_clientLatency[i], 0.99);
+        }
+        for (const auto &link : m_links) {
+            result.clients[link.first >> 32].bytesSent += link.second->GetBytesSent();
+        }
+        size_t bins = static_cast<size_t>(m_params.simTime / m_params.goodputBin);
+        for (size_t i = 0; i < bins; ++i) {
+            uint64_t bytes = i < m_binBytes.size() ? m_binBytes[i] : 0;
+            result.goodputSeries.push_back(bytes * 8.0 / m_params.goodputBin / 1e6);
+        }
+        return result;
+    }
+
+private:
+    static uint64_t LinkKey(uint32_t from, uint32_t to) { return (static_cast<uint64_t>(from) << 32) | to; }
+
+    Ptr<FlClientApp> GetLink(uint32_t from, uint32_t to) {
+        Ptr<FlClientApp> &link = m_links[LinkKey(from, to)];
+        if (!link) {
+            link = CreateObject<FlClientApp>();
+            link->Setup(m_servers[to], m_params.chunkBytes);
+            m_nodes.Get(from)->AddApplication(link);
+        }
+        return link;
+    }
+
+    // Available stations within gossipRange of node (any distance if 0).
+    std::vector<uint32_t> Candidates(uint32_t node) const {
+        Ptr<MobilityModel> self = m_nodes.Get(node)->GetObject<MobilityModel>();
+        std::vector<uint32_t> candidates;
+        for (uint32_t j = 0; j < m_nodes.GetN(); ++j) {
+            if (j == node || !m_table.available[j]) {
+                continue;
+            }
+            if (m_params.gossipRange > 0 &&
+                self->GetDistanceFrom(m_nodes.Get(j)->GetObject<MobilityModel>()) > m_params.gossipRange) {
+                continue;
+            }
+            candidates.push_back(j);
+        }
+        return candidates;
+    }
+
+    void StartRound() {
+        ++m_round;
+        m_roundStart = Simulator::Now();
+        m_completed = 0;
+
+        FlMessageFields fields = MakeUpdateFields(m_params, m_profile, m_round);
+        uint32_t available = 0;
+        for (uint32_t i = 0; i < m_nodes.GetN(); ++i) {
+            if (!m_table.available[i]) {
+                continue;
+            }
+            ++available;
+            fields.clientId = i;
+            for (uint32_t peer : m_selector->Select(i, Candidates(i), m_params.gossipFanout)) {
+                m_outstanding[LinkKey(i, peer)] = m_model[i];
+                GetLink(i, peer)->StartUpload(fields);
+                ++m_table.roundsSelected[i];
+            }
+        }
+        m_roundStartTimes.push_back(m_roundStart.GetSeconds());
+        m_roundAvailable.push_back(available);
+        m_roundSelected.push_back(m_outstanding.size());
+        m_deadline = Simulator::Schedule(Seconds(m_params.roundDeadline), &GossipCoordinator::EndRound, this);
+    }
+
+    void EndRound() {
+        m_roundLatency.push_back((Simulator::Now() - m_roundStart).GetSeconds());
+        m_roundCompleted.push_back(m_completed);
+        for (const auto &exchange : m_outstanding) {
+            m_links[exchange.first]->StopUpload();
+        }
+        m_outstanding.clear();
+
+        double mean = Mean(m_model);
+        double ss = 0.0;
+        for (double x : m_model) {
+            ss += (x - mean) * (x - mean);
+        }
+        m_roundSpread.push_back(std::sqrt(ss / m_model.size()));
+        StartRound();
+    }
+
+    const SimulationParams &m_params;
+    FlModeProfile m_profile;
+    NodeContainer m_nodes;
+    std::vector<Address> m_servers;
+    PeerSelector *m_selector;
+    FlClientTable m_table;
+    std::vector<double> m_model;
+    std::map<uint64_t, Ptr<FlClientApp>> m_links;
+    std::map<uint64_t, double> m_outstanding; // link -> model value sent this round
+    uint32_t m_round = 0;
+    Time m_roundStart;
+    uint32_t m_completed = 0;
+    EventId m_deadline;
+    std::vector<double> m_roundStartTimes;
+    std::vector<uint32_t> m_roundAvailable;
+    std::vector<uint32_t> m_roundSelected;
+    std::vector<double> m_roundLatency;
+    std::vector<uint32_t> m_roundCompleted;
+    std::vector<double> m_roundSpread;
+    std::vector<std::vector<double>> m_clientLatency;
+    std::vector<double> m_updateLatency;
+    std::vector<uint64_t> m_binBytes;
+    uint64_t m_rxBytes = 0;
+    WindowCounters m_window;
+    uint32_t m_windowIndex = 0;
+};
+
+static void GossipChunk(GossipCoordinator *gossip, uint32_t receiver, const FlMessageView &msg) {
+    gossip->OnChunk(receiver, msg);
+}
+
+// ---------------- Client Availability ----------------
+// Switches STAs on and off over the simulated day. "diurnal" runs a
+// two-state Markov chain per client with one step per slot; its on
+// probability follows base + amplitude * cos(2 pi (hour - peak) / 24), and
+// churnRate scales both transition probabilities, so availability tracks
+// the curve while lower rates make sessions longer. "trace" replays
+// "clientId start end" intervals; clients missing from the trace stay on.
+// Switching a client covers every radio it has: each link PHY of each of
+// its band devices.
+class AvailabilityModel {
+public:
+    // radios holds one container per band, each indexed by client.
+    AvailabilityModel(const SimulationParams &params, Callback<void, uint32_t, bool> setAvailable,
+                      const std::vector<NetDeviceContainer> &radios)
+        : m_params(params), m_setAvailable(setAvailable), m_phys(radios.front().GetN()),
+          m_on(radios.front().GetN(), true) {
+        for (const NetDeviceContainer &devices : radios) {
+            for (uint32_t i = 0; i < devices.GetN(); ++i) {
+                Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(devices.Get(i));
+                for (uint8_t link = 0; link < device->GetNPhys(); ++link) {
+                    m_phys[i].push_back(device->GetPhy(link));
+                }
+            }
+        }
+        m_dayLength = params.dayLength > 0 ? params.dayLength : params.simTime;
+        m_slot = params.availabilitySlot > 0 ? params.availabilitySlot : m_dayLength / 24.0;
+        m_uniform = CreateObject<UniformRandomVariable>();
+    }
+
+    void Start() {
+        if (m_params.availability == "diurnal") {
+            // Time 0 runs after node initialization, so the PHYs exist.
+            Simulator::Schedule(Seconds(0), &AvailabilityModel::DiurnalStep, this, true);
+        } else if (m_params.availability == "trace") {
+            LoadTrace();
+        } else {
+            NS_ABORT_MSG_IF(m_params.availability != "always", "Unknown availability " << m_params.availability);
+        }
+    }
+
+    double HourOfDay(double t) const { return std::fmod(m_params.dayStartHour + 24.0 * t / m_dayLength, 24.0); }
+
+private:
+    double OnProbability(double t) const {
+        double p = m_params.diurnalBase +
+                   m_params.diurnalAmplitude * std::cos(2 * M_PI * (HourOfDay(t) - m_params.diurnalPeakHour) / 24.0);
+        return std::min(1.0, std::max(0.0, p));
+    }
+
+    void DiurnalStep(bool initial) {
+        double p = OnProbability(Simulator::Now().GetSeconds());
+        for (uint32_t i = 0; i < m_on.size(); ++i) {
+            double u = m_uniform->GetValue();
+            bool on = initial ? u < p : (m_on[i] ? u >= (1 - p) * m_params.churnRate : u < p * m_params.churnRate);
+            SetOn(i, on);
+        }
+        Simulator::Schedule(Seconds(m_slot), &AvailabilityModel::DiurnalStep, this, false);
+    }
+
+    void LoadTrace() {
+        std::ifstream in(m_params.availabilityTrace);
+        NS_ABORT_MSG_IF(!in, "Cannot open availability trace " << m_params.availabilityTrace);
+        std::vector<std::pair<uint32_t, std::pair<double, double>>> intervals;
+        std::vector<bool> listed(m_on.size(), false);
+        uint32_t client;
+        double start;
+        double end;
+        while (in >> client >> start >> end) {
+            if (client < m_on.size()) {
+                listed[client] = true;
+                intervals.push_back({client, {start, end}});
+            }
+        }
+        // Listed clients start off; their intervals (scheduled afterwards,
+        // so they win at equal times) switch them on.
+        for (uint32_t i = 0; i < m_on.size(); ++i) {
+            if (listed[i]) {
+                Simulator::Schedule(Seconds(0), &AvailabilityModel::SetOn, this, i, false);
+            }
+        }
+        for (const auto &interval : intervals) {
+            Simulator::Schedule(Seconds(interval.second.first), &AvailabilityModel::SetOn, this, interval.first, true);
+            Simulator::Schedule(Seconds(interval.second.second), &AvailabilityModel::SetOn, this, interval.first, false);
+        }
+    }
+
+    void SetOn(uint32_t client, bool on) {
+        if (on == m_on[client]) {
+            return;
+        }
+        m_on[client] = on;
+        for (const Ptr<WifiPhy> &phy : m_phys[client]) {
+            if (on) {
+                phy->ResumeFromOff();
+            } else {
+                phy->SetOffMode();
+            }
+        }
+        m_setAvailable(client, on);
+    }
+
+    const SimulationParams &m_params;
+    Callback<void, uint32_t, bool> m_setAvailable;
+    std::vector<std::vector<Ptr<WifiPhy>>> m_phys; // per client: every radio's PHYs
+    std::vector<bool> m_on;
+    double m_dayLength;
+    double m_slot;
+    Ptr<UniformRandomVariable> m_uniform;
+};
+
+// ---------------- Time Series ----------------
+// Periodic event that closes a metrics window every metricsWindow seconds
+// and keeps the newest metricsCapacity windows in a ring buffer. With
+// liveTrace every window is also written to liveFile as it closes, through
+// the output registry (and so the async writer thread, if enabled).
+class TimeSeriesSampler {
+public:
+    TimeSeriesSampler(const SimulationParams &params, Callback<WindowCounters> takeWindow,
+                      const DeviceEnergyModelContainer &energy, const std::string &liveFile)
+        : m_window(params.metricsWindow), m_takeWindow(takeWindow), m_energy(energy),
+          m_samples(params.metricsCapacity), m_liveFile(params.liveTrace ? liveFile : "") {}
+
+    void Start() {
+        if (m_window > 0) {
+            m_event = Simulator::Schedule(Seconds(m_window), &TimeSeriesSampler::Sample, this);
+        }
+    }
+
+    std::vector<WindowSample> Collect() const {
+        std::vector<WindowSample> samples;
+        for (size_t i = 0; i < m_samples.Size(); ++i) {
+            samples.push_back(m_samples[i]);
+        }
+        return samples;
+    }
+
+private:
+    void Sample() {
+        WindowCounters counters = m_takeWindow();
+        double energy = 0.0;
+        for (uint32_t i = 0; i < m_energy.GetN(); ++i) {
+            energy += m_energy.Get(i)->GetTotalEnergyConsumption();
+        }
+
+        WindowSample sample;
+        sample.time = Simulator::Now().GetSeconds();
+        sample.throughputMbps = counters.rxBytes * 8.0 / m_window / 1e6;
+        sample.meanLatency = counters.latencyCount > 0 ? counters.latencySum / counters.latencyCount : 0.0;
+        sample.energyJ = energy - m_lastEnergy;
+        sample.activeClients = counters.activeClients;
+        m_samples.Push(sample);
+        m_lastEnergy = energy;
+        if (!m_liveFile.empty()) {
+            LogToCsv(m_liveFile, "timeS,throughputMbps,meanLatencyS,energyJ,activeClients",
+                     {sample.time, sample.throughputMbps, sample.meanLatency, sample.energyJ,
+                      static_cast<double>(sample.activeClients)});
+        }
+
+        m_event = Simulator::Schedule(Seconds(m_window), &TimeSeriesSampler::Sample, this);
+    }
+
+    double m_window;
+    Callback<WindowCounters> m_takeWindow;
+    DeviceEnergyModelContainer m_energy;
+    RingBuffer<WindowSample> m_samples;
+    std::string m_liveFile;
+    double m_lastEnergy = 0.0;
+    EventId m_event;
+};
+
+// ---------------- PHY Abstraction ----------------
+// Link-to-system error model for phyModel "eesm"/"miesm". Each received
+// PPDU sees frequency-selective block fading: the channel is cut into
+// CoherenceBandwidth subbands with independent Rayleigh power gains around
+// the SINR the PHY computed, drawn once per PPDU: the PHY's
+// PhyRxPayloadBegin trace marks a new PPDU, so the MPDUs of an A-MPDU,
+// evaluated one by one as each ends, share one draw. The per-subband
+// SINRs are compressed into one effective SINR, and the packet error comes
+// from the AWGN tables of TableBasedErrorRateModel at that SINR. EESM uses exponential compression
+// with a per-constellation beta; MIESM averages the mutual information,
+// approximated as Shannon capacity capped at the constellation's bits.
+// ErrorRateModel::CalculateSnr, which rate control uses for its per-MCS
+// SNR thresholds, probes single-bit chunks; those see the mean channel so
+// the thresholds stay deterministic and increase with MCS.
+class FlL2sErrorRateModel : public ErrorRateModel {
+public:
+    static TypeId GetTypeId() {
+        static TypeId tid = TypeId("ns3::FlL2sErrorRateModel")
+                                .SetParent<ErrorRateModel>()
+                                .SetGroupName("Wifi")
+                                .AddConstructor<FlL2sErrorRateModel>()
+                                .AddAttribute("Mapping", "Effective SINR mapping: eesm or miesm",
+                                              StringValue("eesm"),
+                                              MakeStringAccessor(&FlL2sErrorRateModel::m_mapping),
+                                              MakeStringChecker())
+                                .AddAttribute("CoherenceBandwidth", "Width of an independently faded subband (MHz)",
+                                              DoubleValue(5.0),
+                                              MakeDoubleAccessor(&FlL2sErrorRateModel::m_coherenceMhz),
+                                              MakeDoubleChecker<double>(0.078125));
+        return tid;
+    }
+
+    FlL2sErrorRateModel()
+        : m_table(CreateObject<TableBasedErrorRateModel>()), m_fading(CreateObject<ExponentialRandomVariable>()) {}
+
+    // Connected to the owning PHY's PhyRxPayloadBegin trace.
+    void NotifyRxPayloadBegin(WifiTxVector txVector, Time psduDuration) {
+        m_newPpdu = true;
+    }
+
+private:
+    double DoGetChunkSuccessRate(WifiMode mode, const WifiTxVector &txVector, double snr, uint64_t nbits,
+                                 uint8_t numRxAntennas, WifiPpduField field, uint16_t staId) const override {
+        if (field == WIFI_PPDU_FIELD_DATA && nbits > 1) {
+            snr = EffectiveSnr(mode, txVector.GetChannelWidth(), snr);
+        }
+        return m_table->GetChunkSuccessRate(mode, txVector, snr, nbits, numRxAntennas, field, staId);
+    }
+
+    double EffectiveSnr(WifiMode mode, uint16_t widthMhz, double snr) const {
+        size_t n = std::max<size_t>(1, static_cast<size_t>(widthMhz / m_coherenceMhz));
+        if (m_fade.size() != n || m_newPpdu) {
+            m_fade.resize(n);
+            for (double &f : m_fade) {
+                f = m_fading->GetValue();
+            }
+            m_newPpdu = false;
+        }
+        m_gains.resize(n);
+        double weakest = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < n; ++i) {
+            m_gains[i] = snr * m_fade[i];
+            weakest = std::min(weakest, m_gains[i]);
+        }
+        uint16_t points = std::max<uint16_t>(2, mode.GetConstellationSize());
+        if (m_mapping == "miesm") {
+            double bits = std::log2(static_cast<double>(points));
+            double info = 0.0;
+            for (double g : m_gains) {
+                info += std::min(std::log2(1.0 + g), bits);
+            }
+            info /= n;
+            // Every subband saturated: only the weakest one bounds the SINR.
+            return info < bits ? std::pow(2.0, info) - 1.0 : weakest;
+        }
+        double beta = EesmBeta(points);
+        // Factored around the weakest subband so exp() cannot underflow.
+        double sum = 0.0;
+        for (double g : m_gains) {
+            sum += std::exp(-(g - weakest) / beta);
+        }
+        return weakest - beta * std::log(sum / n);
+    }
+
+    // Typical EESM calibration values per constellation size.
+    static double EesmBeta(uint16_t points) {
+        switch (points) {
+        case 2:
+            return 1.5;
+        case 4:
+            return 1.8;
+        case 16:
+            return 5.0;
+        case 64:
+            return 20.0;
+        case 256:
+            return 60.0;
+        default:
+            return 180.0;
+        }
+    }
+
+    std::string m_mapping;
+    double m_coherenceMhz;
+    Ptr<TableBasedErrorRateModel> m_table;
+    Ptr<ExponentialRandomVariable> m_fading;
+    mutable std::vector<double> m_fade;  // unit-mean power gain per subband of the current PPDU
+    mutable bool m_newPpdu = true;        // a PPDU began since m_fade was drawn
+    mutable std::vector<double> m_gains;  // per-subband SINR
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FlL2sErrorRateModel);
+
+// Gives every PHY of devices its own L2S model, fed by that PHY's trace.
+static void SetPhyModel(const SimulationParams &params, const NetDeviceContainer &devices) {
+    if (params.phyModel == "table") {
+        return;
+    }
+    for (uint32_t i = 0; i < devices.GetN(); ++i) {
+        Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(devices.Get(i))->GetPhy();
+        Ptr<FlL2sErrorRateModel> model = CreateObject<FlL2sErrorRateModel>();
+        model->SetAttribute("Mapping", StringValue(params.phyModel));
+        model->SetAttribute("CoherenceBandwidth", DoubleValue(params.phyCoherenceMhz));
+        phy->SetErrorRateModel(model);
+        phy->TraceConnectWithoutContext("PhyRxPayloadBegin",
+                                        MakeCallback(&FlL2sErrorRateModel::NotifyRxPayloadBegin, model));
+    }
+}
+
+// ---------------- Radio Bands ----------------
+// params.bands lists one radio per band on every node, e.g. "2.4:20,5:80,
+// 6:160". Each band is its own Yans channel, so bands never interfere,
+// with the log-distance reference loss of free space at 1 m for the band.
+struct WifiBandSpec {
+    double ghz = 5.0;
+    uint16_t widthMhz = 20;
+};
+
+static std::vector<WifiBandSpec> ParseBands(const SimulationParams &params) {
+    std::vector<WifiBandSpec> bands;
+    std::stringstream list(params.bands);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        WifiBandSpec band;
+        char sep = 0;
+        std::stringstream fields(item);
+        fields >> band.ghz >> sep >> band.widthMhz;
+        NS_ABORT_MSG_IF(fields.fail() || sep != ':', "Bad band " << item << " (want GHz:MHz)");
+        NS_ABORT_MSG_IF(band.ghz != 2.4 && band.ghz != 5.0 && band.ghz != 6.0, "Unknown band " << band.ghz << " GHz");
+        NS_ABORT_MSG_IF(band.widthMhz > (band.ghz == 2.4 ? 40 : 160), "Channel width " << band.widthMhz
+                        << " MHz not available at " << band.ghz << " GHz");
+        bands.push_back(band);
+    }
+    return bands;
+}
+
+static YansWifiPhyHelper MakeBandPhy(const WifiBandSpec &band) {
+    double referenceLoss = 20.0 * std::log10(4.0 * M_PI * band.ghz * 1e9 / 299792458.0);
+    YansWifiChannelHelper channel;
+    channel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+    channel.AddPropagationLoss("ns3::LogDistancePropagationLossModel", "ReferenceLoss", DoubleValue(referenceLoss));
+    const char *name = band.ghz == 2.4 ? "BAND_2_4GHZ" : band.ghz == 5.0 ? "BAND_5GHZ" : "BAND_6GHZ";
+    YansWifiPhyHelper phy;
+    phy.SetChannel(channel.Create());
+    phy.Set("ChannelSettings", StringValue("{0, " + std::to_string(band.widthMhz) + ", " + name + ", 0}"));
+    return phy;
+}
+
+// ---------------- Network Topology ----------------
+// With nAp > 1 the APs share one SSID and channel and bridge their wifi
+// devices onto a CSMA backbone that holds the FL server, so STAs roam
+// between them without changing address. With one AP the server runs on it.
+// apLayout "grid" packs the APs into a square-ish grid with STAs spread
+// uniformly over it, for dense multi-BSS runs; obssPdLevel then gives
+// every AP its own BSS colour and enables HE spatial reuse.
+//
+// hiddenFraction >= 0 builds a hidden-terminal scenario around one AP:
+// every node reaches exactly hiddenRange (RangePropagationLossModel) and
+// the STAs sit still at 0.9 hiddenRange from the AP in two tight groups on
+// opposite sides, hiddenFraction of them in the far group. The groups
+// cannot hear each other, yet all STAs reach the AP.
+// The "adhoc" topology has no AP and no server: STAs use AdhocWifiMac.
+// With params.bands the AP and every STA get one device per band, band b
+// on subnet 10.(b+1).0.0/16; band 0 is also staDevices/apDevice.
+struct Topology {
+    NodeContainer wifiStaNodes;
+    NodeContainer wifiApNode; // nAp nodes
+    NetDeviceContainer staDevices;
+    NetDeviceContainer apDevice;
+    Ipv4InterfaceContainer staInterfaces;
+    Ptr<Node> serverNode;
+    Ipv4Address serverAddress;
+    DeviceEnergyModelContainer apEnergy;
+    DeviceEnergyModelContainer staEnergy; // packet-level runs only; band b of STA i at b * nSta + i
+    std::vector<double> joinTimes;
+    std::vector<WifiBandSpec> bands;      // empty unless params.bands
+    std::vector<NetDeviceContainer> bandStaDevices;
+    std::vector<NetDeviceContainer> bandApDevices;
+    std::vector<Ipv4Address> bandServerAddress;
+    double hiddenPairs = 0.0; // hidden scenario: STA pairs out of each other's range (fraction)
+};
+
+// Every STA radio: one container per band, each indexed by client.
+static std::vector<NetDeviceContainer> StaRadios(const Topology &topo) {
+    return topo.bands.empty() ? std::vector<NetDeviceContainer>{topo.staDevices} : topo.bandStaDevices;
+}
+
+// Hidden scenario STA positions; sets topo.hiddenPairs.
+static Ptr<ListPositionAllocator> PlaceHiddenStas(const SimulationParams &params, Topology &topo) {
+    Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator>();
+    Ptr<UniformRandomVariable> jitter = CreateObject<UniformRandomVariable>();
+    uint32_t far = static_cast<uint32_t>(std::lround(std::min(1.0, params.hiddenFraction) * params.nSta));
+    double radius = 0.9 * params.hiddenRange;
+    std::vector<Vector> stas;
+    for (uint32_t i = 0; i < params.nSta; ++i) {
+        // +-10 degrees keeps a group within range of itself.
+        double angle = (i < params.nSta - far ? 0.0 : M_PI) + jitter->GetValue(-M_PI / 18, M_PI / 18);
+        stas.push_back(Vector(radius * std::cos(angle), radius * std::sin(angle), 0.0));
+        positions->Add(stas.back());
+    }
+    uint64_t hidden = 0;
+    for (uint32_t i = 0; i < stas.size(); ++i) {
+        for (uint32_t j = i + 1; j < stas.size(); ++j) {
+            hidden += CalculateDistance(stas[i], stas[j]) > params.hiddenRange;
+        }
+    }
+    uint64_t pairs = static_cast<uint64_t>(stas.size()) * (stas.size() - 1) / 2;
+    topo.hiddenPairs = pairs > 0 ? static_cast<double>(hidden) / pairs : 0.0;
+    return positions;
+}
+
+// Columns and rows of the AP grid.
+static std::pair<uint32_t, uint32_t> ApGrid(const SimulationParams &params) {
+    uint32_t cols = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(params.nAp))));
+    return {cols, (params.nAp + cols - 1) / cols};
+}
+
+// Area the STAs are spread over (m^2).
+static double DeploymentArea(const SimulationParams &params) {
+    if (params.apLayout == "grid") {
+        auto grid = ApGrid(params);
+        return grid.first * grid.second * params.apSpacing * params.apSpacing;
+    }
+    return M_PI * params.areaRadius * params.areaRadius;
+}
+
+static Ptr<WifiMac> GetWifiMac(Ptr<NetDevice> device) {
+    return DynamicCast<WifiNetDevice>(device)->GetMac();
+}
+
+// Installs a permanent ARP entry for ip -> mac in the cache of the interface
+// bound to device.
+static void AddPermanentArp(Ptr<NetDevice> device, Ipv4Address ip, Address mac) {
+    Ptr<Ipv4L3Protocol> ipv4 = device->GetNode()->GetObject<Ipv4L3Protocol>();
+    Ptr<ArpCache> cache = ipv4->GetInterface(ipv4->GetInterfaceForDevice(device))->GetArpCache();
+    ArpCache::Entry *entry = cache->Add(ip);
+    entry->SetMacAddress(mac);
+    entry->MarkPermanent();
+}
+
+static Topology BuildTopology(const SimulationParams &params) {
+    NS_ABORT_MSG_IF(params.flTopology != "infra" && params.flTopology != "adhoc",
+                    "Unknown FL topology " << params.flTopology);
+    NS_ABORT_MSG_IF(params.flTopology == "adhoc" && params.flProtocol == "split",
+                    "Split learning needs the infra topology");
+    bool adhoc = params.flTopology == "adhoc";
+    Topology topo;
+    topo.bands = ParseBands(params);
+    NS_ABORT_MSG_IF(!topo.bands.empty() && (adhoc || params.nAp != 1), "Multi-band runs need infra with one AP");
+    NS_ABORT_MSG_IF(!topo.bands.empty() && params.channelWidth != 0,
+                    "channelWidth does not apply with bands; give each band's width in bands (GHz:MHz)");
+    NS_ABORT_MSG_IF(params.apLayout != "line" && params.apLayout != "grid", "Unknown AP layout " << params.apLayout);
+    NS_ABORT_MSG_IF(params.channelWidth != 0 && params.channelWidth != 20 && params.channelWidth != 40 &&
+                        params.channelWidth != 80 && params.channelWidth != 160,
+                    "Unsupported channel width " << params.channelWidth);
+    NS_ABORT_MSG_IF(params.phyModel != "table" && params.phyModel != "eesm" && params.phyModel != "miesm",
+                    "Unknown PHY model " << params.phyModel);
+    NS_ABORT_MSG_IF(params.phyCoherenceMhz <= 0.0, "phyCoherenceMhz must be positive");
+    bool hidden = params.hiddenFraction >= 0.0;
+    NS_ABORT_MSG_IF(hidden && (adhoc || params.nAp != 1 || !topo.bands.empty()),
+                    "The hidden-terminal scenario needs infra with one AP on one band");
+    NodeContainer wifiStaNodes;
+    wifiStaNodes.Create(params.nSta);
+    NodeContainer wifiApNode;
+    wifiApNode.Create(adhoc ? 0 : params.nAp);
+
+    YansWifiPhyHelper phy;
+    if (topo.bands.empty()) {
+        YansWifiChannelHelper channel;
+        if (hidden) {
+            channel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+            channel.AddPropagationLoss("ns3::RangePropagationLossModel", "MaxRange", DoubleValue(params.hiddenRange));
+        } else {
+            channel = YansWifiChannelHelper::Default();
+        }
+        phy.SetChannel(channel.Create());
+        if (params.channelWidth > 0) {
+            phy.Set("ChannelSettings", StringValue("{0, " + std::to_string(params.channelWidth) + ", BAND_5GHZ, 0}"));
+        }
+    } else {
+        phy = MakeBandPhy(topo.bands[0]);
+    }
+
+    WifiMacHelper mac;
+    WifiHelper wifi;
+    wifi.SetStandard(WIFI_STANDARD_80211ax);
+    wifi.SetRemoteStationManager("ns3::IdealWifiManager");
+    if (params.obssPdLevel != 0.0) {
+        wifi.SetObssPdAlgorithm("ns3::ConstantObssPdAlgorithm", "ObssPdLevel", DoubleValue(params.obssPdLevel));
+    }
+
+    Ssid ssid = Ssid("ns3-wifi");
+    topo.joinTimes = ComputeJoinTimes(params);
+    // Every schedule but "all" parks the STAs until their join time.
+    Ssid staSsid = params.joinSchedule == "all" ? ssid : Ssid(kParkedSsid);
+    if (adhoc) {
+        mac.SetType("ns3::AdhocWifiMac");
+    } else {
+        mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(staSsid), "ActiveProbing", BooleanValue(false));
+    }
+    NetDeviceContainer staDevices = wifi.Install(phy, mac, wifiStaNodes);
+    SetPhyModel(params, staDevices);
+
+    mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
+    NetDeviceContainer apDevice = wifi.Install(phy, mac, wifiApNode);
+    SetPhyModel(params, apDevice);
+    if (params.obssPdLevel != 0.0) {
+        for (uint32_t k = 0; k < apDevice.GetN(); ++k) {
+            Ptr<HeConfiguration> he = DynamicCast<WifiNetDevice>(apDevice.Get(k))->GetHeConfiguration();
+            he->SetAttribute("BssColor", UintegerValue(k % 63 + 1));
+        }
+    }
+
+    if (!topo.bands.empty()) {
+        topo.bandStaDevices.push_back(staDevices);
+        topo.bandApDevices.push_back(apDevice);
+    }
+    for (size_t b = 1; b < topo.bands.size(); ++b) {
+        YansWifiPhyHelper bandPhy = MakeBandPhy(topo.bands[b]);
+        mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(staSsid), "ActiveProbing", BooleanValue(false));
+        topo.bandStaDevices.push_back(wifi.Install(bandPhy, mac, wifiStaNodes));
+        SetPhyModel(params, topo.bandStaDevices.back());
+        mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
+        topo.bandApDevices.push_back(wifi.Install(bandPhy, mac, wifiApNode));
+        SetPhyModel(params, topo.bandApDevices.back());
+    }
+
+    if (!adhoc && params.joinSchedule != "all") {
+        for (uint32_t i = 0; i < params.nSta; ++i) {
+            Simulator::Schedule(Seconds(topo.joinTimes[i]), &JoinBss, GetWifiMac(staDevices.Get(i)), ssid);
+            for (size_t b = 1; b < topo.bands.size(); ++b) {
+                Simulator::Schedule(Seconds(topo.joinTimes[i]), &JoinBss, GetWifiMac(topo.bandStaDevices[b].Get(i)),
+                                    ssid);
+            }
+        }
+    }
+
+    // RandomWaypointMobilityModel needs its own position allocator; STAs
+    // start and roam inside a disc of areaRadius around the origin. APs sit
+    // on the x axis, apSpacing apart and centred on the origin. In the grid
+    // layout both APs and STAs cover the grid's rectangle instead.
+    Ptr<PositionAllocator> staArea;
+    Ptr<ListPositionAllocator> apPosition = CreateObject<ListPositionAllocator>();
+    if (params.apLayout == "grid") {
+        auto grid = ApGrid(params);
+        double halfX = grid.first * params.apSpacing / 2.0;
+        double halfY = grid.second * params.apSpacing / 2.0;
+        Ptr<RandomRectanglePositionAllocator> rectangle = CreateObject<RandomRectanglePositionAllocator>();
+        rectangle->SetAttribute("X", StringValue("ns3::UniformRandomVariable[Min=" + std::to_string(-halfX) +
+                                                 "|Max=" + std::to_string(halfX) + "]"));
+        rectangle->SetAttribute("Y", StringValue("ns3::UniformRandomVariable[Min=" + std::to_string(-halfY) +
+                                                 "|Max=" + std::to_string(halfY) + "]"));
+        staArea = rectangle;
+        for (uint32_t k = 0; k < wifiApNode.GetN(); ++k) {
+            apPosition->Add(Vector((k % grid.first + 0.5) * params.apSpacing - halfX,
+                                   (k / grid.first + 0.5) * params.apSpacing - halfY, 0.0));
+        }
+    } else {
+        Ptr<RandomDiscPositionAllocator> disc = CreateObject<RandomDiscPositionAllocator>();
+        disc->SetAttribute("Rho", StringValue("ns3::UniformRandomVariable[Min=0|Max=" +
+                                              std::to_string(params.areaRadius) + "]"));
+        staArea = disc;
+        for (uint32_t k = 0; k < wifiApNode.GetN(); ++k) {
+            apPosition->Add(Vector((k - (params.nAp - 1) / 2.0) * params.apSpacing, 0.0, 0.0));
+        }
+    }
+
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator(staArea);
+    if (hidden) {
+        mobility.SetPositionAllocator(PlaceHiddenStas(params, topo));
+        mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    } else if (params.staSpeed > 0) {
+        mobility.SetMobilityModel("ns3::RandomWaypointMobilityModel", "PositionAllocator", PointerValue(staArea),
+                                  "Speed", StringValue("ns3::ConstantRandomVariable[Constant=" +
+                                                       std::to_string(params.staSpeed) + "]"));
+    } else {
+        mobility.SetMobilityModel("ns3::RandomWaypointMobilityModel", "PositionAllocator", PointerValue(staArea));
+    }
+    mobility.Install(wifiStaNodes);
+    mobility.SetPositionAllocator(apPosition);
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(wifiApNode);
+
+    InternetStackHelper stack;
+    stack.Install(wifiStaNodes);
+    stack.Install(wifiApNode);
+
+    // A /16 so that nSta beyond 253 still gets distinct addresses.
+    Ipv4AddressHelper address;
+    address.SetBase("10.1.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer staInterfaces = address.Assign(staDevices);
+    Ptr<NetDevice> serverLanDevice;
+    if (wifiApNode.GetN() == 1) {
+        topo.serverNode = wifiApNode.Get(0);
+        topo.serverAddress = address.Assign(apDevice).GetAddress(0);
+        if (!topo.bands.empty()) {
+            topo.bandServerAddress.push_back(topo.serverAddress);
+        }
+        for (size_t b = 1; b < topo.bands.size(); ++b) {
+            address.SetBase(Ipv4Address(("10." + std::to_string(b + 1) + ".0.0").c_str()), "255.255.0.0");
+            address.Assign(topo.bandStaDevices[b]);
+            topo.bandServerAddress.push_back(address.Assign(topo.bandApDevices[b]).GetAddress(0));
+        }
+    } else if (wifiApNode.GetN() > 1) {
+        NodeContainer serverNode;
+        serverNode.Create(1);
+        stack.Install(serverNode);
+
+        CsmaHelper csma;
+        csma.SetChannelAttribute("DataRate", DataRateValue(DataRate("10Gbps")));
+        csma.SetChannelAttribute("Delay", TimeValue(MicroSeconds(10)));
+        NetDeviceContainer lanDevices = csma.Install(NodeContainer(serverNode, wifiApNode));
+        BridgeHelper bridge;
+        for (uint32_t k = 0; k < params.nAp; ++k) {
+            NetDeviceContainer ports;
+            ports.Add(apDevice.Get(k));
+            ports.Add(lanDevices.Get(k + 1));
+            bridge.Install(wifiApNode.Get(k), ports);
+        }
+        topo.serverNode = serverNode.Get(0);
+        serverLanDevice = lanDevices.Get(0);
+        topo.serverAddress = address.Assign(NetDeviceContainer(serverLanDevice)).GetAddress(0);
+    }
+    // Every node is on-link to its peers (STAs, the server behind bridged
+    // APs), so the connected routes InternetStackHelper installs are the
+    // whole routing table; only ARP is dynamic. Static entries for all
+    // assigned addresses remove the start-up ARP exchanges.
+    if (params.staticArp) {
+        NeighborCacheHelper neighbors;
+        neighbors.PopulateNeighborCache();
+        // PopulateNeighborCache only pairs interfaces on the same channel,
+        // and the bridge ports that join the Wi-Fi cells to the CSMA
+        // backbone carry no IP, so with several APs the STA <-> server
+        // pairs are missing. The bridges forward by MAC, so each side gets
+        // the other's own device address.
+        if (serverLanDevice) {
+            for (uint32_t i = 0; i < staDevices.GetN(); ++i) {
+                AddPermanentArp(staDevices.Get(i), topo.serverAddress, serverLanDevice->GetAddress());
+                AddPermanentArp(serverLanDevice, staInterfaces.GetAddress(i), staDevices.Get(i)->GetAddress());
+            }
+        }
+    }
+
+    // ---------------- Energy Model ----------------
+    BasicEnergySourceHelper energySourceHelper;
+    energySourceHelper.Set("BasicEnergySupplyVoltageV", DoubleValue(3.0));
+    EnergySourceContainer sources = energySourceHelper.Install(wifiApNode);
+
+    WifiRadioEnergyModelHelper radioEnergyHelper;
+    DeviceEnergyModelContainer deviceModels = radioEnergyHelper.Install(apDevice, sources);
+    for (size_t b = 1; b < topo.bands.size(); ++b) {
+        deviceModels.Add(radioEnergyHelper.Install(topo.bandApDevices[b], sources));
+    }
+
+    if (params.packetLevel) {
+        energySourceHelper.Set("BasicEnergySourceInitialEnergyJ", DoubleValue(params.staBatteryJ));
+        EnergySourceContainer staSources = energySourceHelper.Install(wifiStaNodes);
+        topo.staEnergy = radioEnergyHelper.Install(staDevices, staSources);
+        for (size_t b = 1; b < topo.bands.size(); ++b) {
+            topo.staEnergy.Add(radioEnergyHelper.Install(topo.bandStaDevices[b], staSources));
+        }
+    }
+
+    topo.wifiStaNodes = wifiStaNodes;
+    topo.wifiApNode = wifiApNode;
+    topo.staDevices = staDevices;
+    topo.apDevice = apDevice;
+    topo.staInterfaces = staInterfaces;
+    topo.apEnergy = deviceModels;
+    return topo;
+}
+
+// ---------------- Packet-Level Run ----------------
+// Job j's server listens on TCP 9000 + j and broadcasts cluster models to
+// UDP 9000 + j + kFlDownlinkPortOffset.
+static const uint16_t kFlDownlinkPortOffset = 100;
+// Band b > 0 of a multi-band run has its own server on port + b * offset.
+static const uint16_t kFlBandPortOffset = 1000;
+
+static void CountBandRx(uint64_t *bytes, const FlMessageView &msg) {
+    *bytes += msg.ChunkBytes();
+}
+
+// Multi-band: one more server and client app per extra band, all feeding
+// the job's coordinator, which splits each update across the links with
+// channel widths as nominal capacities.
+static void AddBandLinks(const SimulationParams &params, const Topology &topo, FlJob &job, uint16_t port,
+                         std::vector<uint64_t> &bandRx) {
+    std::vector<std::vector<Ptr<FlClientApp>>> links = {job.clients};
+    std::vector<double> widths = {static_cast<double>(topo.bands[0].widthMhz)};
+    job.server->TraceConnectWithoutContext("ChunkRx", MakeBoundCallback(&CountBandRx, &bandRx[0]));
+    for (uint32_t b = 1; b < topo.bands.size(); ++b) {
+        uint16_t bandPort = port + b * kFlBandPortOffset;
+        Ptr<FlServerApp> server = CreateObject<FlServerApp>();
+        server->SetAttribute("Port", UintegerValue(bandPort));
+        topo.serverNode->AddApplication(server);
+        server->TraceConnectWithoutContext("ChunkRx", MakeCallback(&FlCoordinator::OnChunk, job.coordinator.get()));
+        server->TraceConnectWithoutContext("ChunkRx", MakeBoundCallback(&CountBandRx, &bandRx[b]));
+        links.emplace_back();
+        for (uint32_t sta : job.stas) {
+            Ptr<FlClientApp> client = CreateObject<FlClientApp>();
+            client->Setup(InetSocketAddress(topo.bandServerAddress[b], bandPort), params.chunkBytes);
+            topo.wifiStaNodes.Get(sta)->AddApplication(client);
+            links.back().push_back(client);
+        }
+        widths.push_back(topo.bands[b].widthMhz);
+    }
+    job.coordinator->SetLinks(links, widths);
+}
+
+// One simulation of params.nSta STAs running FL rounds in the given mode.
+// Returns the first job's result; with params.jobs every job is also
+// reported in jobResults. The time series covers all jobs.
+static PacketLevelResult RunPacketLevel(const SimulationParams &params, const std::string &mode,
+                                        std::vector<JobResult> &jobResults) {
+    NS_ABORT_MSG_IF(params.handoverPolicy != "resume" && params.handoverPolicy != "restart",
+                    "Unknown handover policy " << params.handoverPolicy);
+    NS_ABORT_MSG_IF(params.flProtocol != "fedavg" && params.flProtocol != "split",
+                    "Unknown FL protocol " << params.flProtocol);
+    NS_ABORT_MSG_IF(params.jobScheduling != "drr" && params.jobScheduling != "none",
+                    "Unknown job scheduling " << params.jobScheduling);
+    NS_ABORT_MSG_IF(params.bandSplit != "first" && params.bandSplit != "even" && params.bandSplit != "capacity" &&
+                        params.bandSplit != "adaptive",
+                    "Unknown band split " << params.bandSplit);
+    NS_ABORT_MSG_IF(params.submodel != "full" && params.submodel != "dropout", "Unknown submodel " << params.submodel);
+    NS_ABORT_MSG_IF(params.uploadOrder != "sequential" && params.uploadOrder != "importance",
+                    "Unknown upload order " << params.uploadOrder);
+    NS_ABORT_MSG_IF(params.clusters > 0 && (params.clusterGroups == 0 || params.clusterDim == 0),
+                    "Clustered FL needs clusterGroups and clusterDim > 0");
+    Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(1448));
+    Config::SetDefault("ns3::WifiRemoteStationManager::RtsCtsThreshold", UintegerValue(RtsCtsThreshold(params, mode)));
+    Topology topo = BuildTopology(params);
+
+    std::vector<FlJobSpec> specs = ParseJobs(params);
+    std::vector<double> weights;
+    for (const FlJobSpec &spec : specs) {
+        weights.push_back(spec.weight);
+    }
+    std::vector<double> staAirtime;
+    std::vector<double> apAirtime;
+    ConnectAirtime(topo.staDevices, staAirtime);
+    ConnectAirtime(topo.apDevice, apAirtime);
+    JobScheduler scheduler(weights, params.jobQuantum, staAirtime);
+    bool scheduled = specs.size() > 1 && params.jobScheduling == "drr";
+    NS_ABORT_MSG_IF(specs.size() > 1 && topo.bands.size() > 1, "Multi-band runs support a single FL job");
+    size_t nBands = topo.bands.size();
+    std::vector<uint64_t> bandRx(nBands, 0);
+    std::vector<std::vector<double>> bandStaAirtime(nBands);
+    std::vector<std::vector<double>> bandApAirtime(nBands);
+    std::vector<std::vector<double>> bandBusy(nBands);
+    for (size_t b = 0; b < nBands; ++b) {
+        ConnectAirtime(topo.bandStaDevices[b], bandStaAirtime[b]);
+        ConnectAirtime(topo.bandApDevices[b], bandApAirtime[b]);
+        ConnectBusyTime(topo.bandApDevices[b], bandBusy[b]);
+    }
+
+    FlJobList jobs;
+    double sliceStart = 0.0;
+    for (uint32_t j = 0; j < specs.size(); ++j) {
+        auto job = std::make_unique<FlJob>();
+        job->spec = specs[j];
+        job->params = params;
+        job->params.modelBytes = specs[j].modelBytes;
+        job->params.roundDeadline = specs[j].roundDeadline;
+        job->clientOf.assign(params.nSta, -1);
+        uint32_t first = static_cast<uint32_t>(sliceStart * params.nSta);
+        uint32_t count = std::min(params.nSta, std::max<uint32_t>(1, std::lround(specs[j].clientFraction * params.nSta)));
+        sliceStart += specs[j].clientFraction;
+
+        uint16_t port = 9000 + j;
+        job->server = CreateObject<FlServerApp>();
+        job->server->SetAttribute("Port", UintegerValue(port));
+        topo.serverNode->AddApplication(job->server);
+        Address serverAddress = InetSocketAddress(topo.serverAddress, port);
+        std::vector<double> joinTimes;
+        for (uint32_t k = 0; k < count; ++k) {
+            uint32_t sta = (first + k) % params.nSta;
+            Ptr<FlClientApp> client = CreateObject<FlClientApp>();
+            client->Setup(serverAddress, params.chunkBytes);
+            topo.wifiStaNodes.Get(sta)->AddApplication(client);
+            if (scheduled) {
+                scheduler.AddClient(j, sta, PeekPointer(client));
+                client->SetGate(MakeBoundCallback(&JobGate, &scheduler, j, k));
+            }
+            job->clientOf[sta] = k;
+            job->stas.push_back(sta);
+            job->clients.push_back(client);
+            joinTimes.push_back(topo.joinTimes[sta]);
+        }
+
+        job->coordinator = std::make_unique<FlCoordinator>(job->params, GetModeProfile(mode), job->clients, joinTimes);
+        job->coordinator->SetServer(job->server, port + kFlDownlinkPortOffset);
+        job->server->TraceConnectWithoutContext("ChunkRx", MakeCallback(&FlCoordinator::OnChunk, job->coordinator.get()));
+        for (uint32_t k = 0; k < count; ++k) {
+            job->clients[k]->TraceConnectWithoutContext(
+                "MessageRx", MakeCallback(&FlCoordinator::OnClientMessage, job->coordinator.get()));
+            if (params.clusters > 0) {
+                job->clients[k]->ListenBroadcast(port + kFlDownlinkPortOffset);
+                job->clients[k]->TraceConnectWithoutContext(
+                    "MessageRx", MakeBoundCallback(&ClusterModelRx, job->coordinator.get(), k));
+            }
+        }
+        if (nBands > 1) {
+            AddBandLinks(params, topo, *job, port, bandRx);
+        }
+        job->coordinator->ScheduleStartTimeout();
+        jobs.push_back(std::move(job));
+    }
+    if (scheduled) {
+        scheduler.Start();
+    }
+
+    std::vector<uint32_t> drops(params.nSta, 0);
+    uint64_t staTx = 0;
+    uint64_t dataFailures = 0;
+    uint64_t rtsFailures = 0;
+    for (uint32_t i = 0; i < params.nSta; ++i) {
+        Ptr<WifiNetDevice> staDevice = DynamicCast<WifiNetDevice>(topo.staDevices.Get(i));
+        Ptr<WifiRemoteStationManager> manager = staDevice->GetRemoteStationManager();
+        manager->TraceConnectWithoutContext("MacTxDataFailed", MakeBoundCallback(&CountStationEvent, &dataFailures));
+        manager->TraceConnectWithoutContext("MacTxRtsFailed", MakeBoundCallback(&CountStationEvent, &rtsFailures));
+        staDevice->GetPhy()->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&CountTxBegin, &staTx));
+        Ptr<WifiMac> staMac = staDevice->GetMac();
+        staMac->TraceConnectWithoutContext("Assoc", MakeBoundCallback(&JobsAssociated, &jobs, i));
+        staMac->TraceConnectWithoutContext("DeAssoc", MakeBoundCallback(&JobsDisassociated, &jobs, i));
+        staMac->TraceConnectWithoutContext("MacTxDrop", MakeBoundCallback(&CountMacTxDrop, &drops[i]));
+        staDevice->GetRemoteStationManager()->TraceConnectWithoutContext(
+            "MacTxFinalDataFailed", MakeBoundCallback(&CountFinalDataFailure, &drops[i]));
+        for (size_t b = 1; b < nBands; ++b) {
+            Ptr<WifiNetDevice> bandDevice = DynamicCast<WifiNetDevice>(topo.bandStaDevices[b].Get(i));
+            bandDevice->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeBoundCallback(&CountMacTxDrop, &drops[i]));
+            bandDevice->GetRemoteStationManager()->TraceConnectWithoutContext(
+                "MacTxFinalDataFailed", MakeBoundCallback(&CountFinalDataFailure, &drops[i]));
+        }
+    }
+
+    AvailabilityModel availability(params, MakeBoundCallback(&JobsSetAvailable, &jobs), StaRadios(topo));
+    availability.Start();
+
+    DeviceEnergyModelContainer energyModels;
+    energyModels.Add(topo.staEnergy);
+    energyModels.Add(topo.apEnergy);
+    TimeSeriesSampler sampler(params, MakeBoundCallback(&JobsTakeWindow, &jobs), energyModels,
+                              params.outputPrefix + "results_" + mode + "_live.csv");
+    sampler.Start();
+
+    ArpCounter arp;
+    for (size_t b = 0; b < std::max<size_t>(1, nBands); ++b) {
+        ConnectArpCounter(nBands > 0 ? topo.bandStaDevices[b] : topo.staDevices, arp);
+        ConnectArpCounter(nBands > 0 ? topo.bandApDevices[b] : topo.apDevice, arp);
+    }
+    uint64_t apRxFrames = 0;
+    uint64_t apRxDropped = 0;
+    for (size_t b = 0; b < std::max<size_t>(1, nBands); ++b) {
+        const NetDeviceContainer &aps = nBands > 0 ? topo.bandApDevices[b] : topo.apDevice;
+        for (uint32_t k = 0; k < aps.GetN(); ++k) {
+            Ptr<WifiPhy> apPhy = DynamicCast<WifiNetDevice>(aps.Get(k))->GetPhy();
+            apPhy->TraceConnectWithoutContext("PhyRxEnd", MakeBoundCallback(&CountRxEnd, &apRxFrames));
+            apPhy->TraceConnectWithoutContext("PhyRxDrop", MakeBoundCallback(&CountRxDrop, &apRxDropped));
+        }
+    }
+
+    Simulator::ScheduleDestroy(&FlushOutputs);
+    Simulator::Stop(Seconds(params.simTime));
+    auto wallStart = std::chrono::steady_clock::now();
+    Simulator::Run();
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double totalApAirtime = Sum(apAirtime);
+    std::vector<BandResult> bands(nBands);
+    for (size_t b = 0; b < nBands; ++b) {
+        bands[b].ghz = topo.bands[b].ghz;
+        bands[b].widthMhz = topo.bands[b].widthMhz;
+        bands[b].rxBytes = bandRx[b];
+        bands[b].apTxS = Sum(bandApAirtime[b]);
+        bands[b].staTxS = Sum(bandStaAirtime[b]);
+        bands[b].busyS = Sum(bandBusy[b]);
+        totalApAirtime += b > 0 ? bands[b].apTxS : 0.0;
+    }
+    // STA airtime is split between the jobs sharing the STA by bytes sent.
+    std::vector<uint64_t> staBytes(params.nSta, 0);
+    for (const auto &job : jobs) {
+        for (uint32_t k = 0; k < job->stas.size(); ++k) {
+            staBytes[job->stas[k]] += job->clients[k]->GetBytesSent();
+        }
+    }
+    // STA-level values (energy, drops, airtime) repeat in every job of the STA.
+    std::vector<PacketLevelResult> results;
+    for (uint32_t j = 0; j < jobs.size(); ++j) {
+        const FlJob &job = *jobs[j];
+        PacketLevelResult result = job.coordinator->Collect();
+        result.timeSeries = sampler.Collect();
+        result.apAirtime = totalApAirtime;
+        result.bands = bands;
+        result.hiddenPairs = topo.hiddenPairs;
+        result.staTxAttempts = staTx;
+        result.dataFailures = dataFailures;
+        result.rtsFailures = rtsFailures;
+        result.apRxFrames = apRxFrames;
+        result.apRxDropped = apRxDropped;
+        result.wallS = wallS;
+        result.arpFrames = arp.frames;
+        result.arpBytes = arp.bytes;
+        for (uint32_t k = 0; k < job.stas.size(); ++k) {
+            uint32_t sta = job.stas[k];
+            result.clients[k].drops = drops[sta];
+            result.clients[k].airtimeS = staAirtime[sta];
+            for (size_t b = 1; b < nBands; ++b) {
+                result.clients[k].airtimeS += bandStaAirtime[b][sta];
+            }
+            for (uint32_t e = sta; e < topo.staEnergy.GetN(); e += params.nSta) {
+                result.clients[k].energyJ += topo.staEnergy.Get(e)->GetTotalEnergyConsumption();
+            }
+        }
+        if (!params.jobs.empty()) {
+            JobResult jobResult;
+            jobResult.name = job.spec.name;
+            jobResult.weight = job.spec.weight;
+            jobResult.clients = job.stas.size();
+            jobResult.airtimeGranted = scheduler.GetGranted(j);
+            for (uint32_t k = 0; k < job.stas.size(); ++k) {
+                uint32_t sta = job.stas[k];
+                if (staBytes[sta] > 0) {
+                    jobResult.airtimeMeasured +=
+                        staAirtime[sta] * job.clients[k]->GetBytesSent() / static_cast<double>(staBytes[sta]);
+                }
+            }
+            jobResult.result = result;
+            jobResults.push_back(jobResult);
+        }
+        results.push_back(result);
+    }
+    Simulator::Destroy();
+
+    NS_LOG_UNCOND("Packet-level run done for mode=" << mode << ": " << results[0].roundLatency.size()
+                  << " rounds, goodput=" << results[0].goodputMbps << " Mbps");
+    return results[0];
+}
+
+// ---------------- Gossip Run ----------------
+// Gossip FL over the ad-hoc topology: every STA runs an FlServerApp and
+// sends its model to the peers its selector picks.
+static PacketLevelResult RunGossip(const SimulationParams &params, const std::string &mode) {
+    Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(1448));
+    Topology topo = BuildTopology(params);
+
+    const uint16_t port = 9000;
+    std::vector<Ptr<FlServerApp>> servers;
+    std::vector<Address> serverAddresses;
+    for (uint32_t i = 0; i < params.nSta; ++i) {
+        Ptr<FlServerApp> server = CreateObject<FlServerApp>();
+        server->SetAttribute("Port", UintegerValue(port));
+        topo.wifiStaNodes.Get(i)->AddApplication(server);
+        servers.push_back(server);
+        serverAddresses.push_back(InetSocketAddress(topo.staInterfaces.GetAddress(i), port));
+    }
+
+    std::unique_ptr<PeerSelector> selector = CreatePeerSelector(params.gossipPeers, topo.wifiStaNodes);
+    GossipCoordinator gossip(params, GetModeProfile(mode), topo.wifiStaNodes, serverAddresses, selector.get());
+    std::vector<uint32_t> drops(params.nSta, 0);
+    for (uint32_t i = 0; i < params.nSta; ++i) {
+        servers[i]->TraceConnectWithoutContext("ChunkRx", MakeBoundCallback(&GossipChunk, &gossip, i));
+        Ptr<WifiNetDevice> staDevice = DynamicCast<WifiNetDevice>(topo.staDevices.Get(i));
+        staDevice->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeBoundCallback(&CountMacTxDrop, &drops[i]));
+        staDevice->GetRemoteStationManager()->TraceConnectWithoutContext(
+            "MacTxFinalDataFailed", MakeBoundCallback(&CountFinalDataFailure, &drops[i]));
+    }
+    std::vector<double> staAirtime;
+    ConnectAirtime(topo.staDevices, staAirtime);
+    ArpCounter arp;
+    ConnectArpCounter(topo.staDevices, arp);
+    gossip.Start();
+
+    AvailabilityModel availability(params, MakeCallback(&GossipCoordinator::SetAvailable, &gossip), StaRadios(topo));
+    availability.Start();
+    TimeSeriesSampler sampler(params, MakeCallback(&GossipCoordinator::TakeWindow, &gossip), topo.staEnergy,
+                              params.outputPrefix + "results_" + mode + "_live.csv");
+    sampler.Start();
+
+    Simulator::ScheduleDestroy(&FlushOutputs);
+    Simulator::Stop(Seconds(params.simTime));
+    Simulator::Run();
+    PacketLevelResult result = gossip.Collect();
+    result.timeSeries = sampler.Collect();
+    result.arpFrames = arp.frames;
+    result.arpBytes = arp.bytes;
+    for (uint32_t i = 0; i < params.nSta; ++i) {
+        result.clients[i].energyJ = topo.staEnergy.Get(i)->GetTotalEnergyConsumption();
+        result.clients[i].drops = drops[i];
+        result.clients[i].airtimeS = staAirtime[i];
+    }
+    Simulator::Destroy();
+
+    NS_LOG_UNCOND("Gossip run done for mode=" << mode << ": " << result.roundLatency.size()
+                  << " rounds, goodput=" << result.goodputMbps << " Mbps");
+    return result;
+}
+
+// ---------------- Scenario Runner ----------------
+static void AddParams(CommandLine &cmd, SimulationParams &params) {
+    cmd.AddValue("nSta", "Number of stations", params.nSta);
+    cmd.AddValue("dpEpsilon", "Differential privacy budget ε", params.dpEpsilon);
+    cmd.AddValue("compression", "Output compression: none, gzip or zstd", params.compression);
+    cmd.AddValue("compressionLevel", "Compression level passed to gzip/zstd", params.compressionLevel);
+    cmd.AddValue("csvPrecision", "Significant digits in result files (0 = shortest round-trip)", params.csvPrecision);
+    cmd.AddValue("asyncQueue", "Records queued for the background writer thread (0 = synchronous writes)", params.asyncQueue);
+    cmd.AddValue("seed", "RNG seed", params.seed);
+    cmd.AddValue("run", "RNG run number", params.run);
+    cmd.AddValue("outputPrefix", "Prefix for result file names", params.outputPrefix);
+    cmd.AddValue("scenarioFile", "File with one scenario (command-line overrides) per line", params.scenarioFile);
+    cmd.AddValue("packetLevel", "Run packet-level FL rounds for every mode", params.packetLevel);
+    cmd.AddValue("modelBytes", "Uncompressed model update size (bytes)", params.modelBytes);
+    cmd.AddValue("chunkBytes", "Payload bytes per FL message", params.chunkBytes);
+    cmd.AddValue("uploadOrder", "Update chunk order: sequential or importance", params.uploadOrder);
+    cmd.AddValue("trainTime", "Local training time of the full model on the fastest client (s)", params.trainTime);
+    cmd.AddValue("computeSpread", "Client compute slowdown, uniform in [1, spread]", params.computeSpread);
+    cmd.AddValue("submodel", "Client model: full or dropout (sized to link rate and compute)", params.submodel);
+    cmd.AddValue("submodelBudget", "Dropout: share of the round deadline a client may use", params.submodelBudget);
+    cmd.AddValue("submodelMin", "Dropout: smallest sub-model fraction", params.submodelMin);
+    cmd.AddValue("submodelBlocks", "Dropout: model blocks tracked for reconstruction", params.submodelBlocks);
+    cmd.AddValue("importanceExponent", "Importance order: value share x^e of a prefix x", params.importanceExponent);
+    cmd.AddValue("roundDeadline", "FL round deadline (s)", params.roundDeadline);
+    cmd.AddValue("areaRadius", "Radius of the STA area around the origin (m)", params.areaRadius);
+    cmd.AddValue("nAp", "Number of APs bridged to the FL server backbone", params.nAp);
+    cmd.AddValue("apSpacing", "Distance between neighbouring APs (m)", params.apSpacing);
+    cmd.AddValue("apLayout", "AP placement: line or grid (dense multi-BSS)", params.apLayout);
+    cmd.AddValue("channelWidth", "Channel width (MHz: 20, 40, 80, 160; 0 = default)", params.channelWidth);
+    cmd.AddValue("hiddenFraction", "Hidden-terminal scenario: share of STAs opposite the rest (<0 = off)",
+                 params.hiddenFraction);
+    cmd.AddValue("hiddenRange", "Hidden-terminal scenario: radio range (m)", params.hiddenRange);
+    cmd.AddValue("rtsCts", "RTS/CTS policy off|always|<bytes>, per mode as MODE:policy (comma list)", params.rtsCts);
+    cmd.AddValue("phyModel", "Frame error model: table, eesm or miesm (frequency-selective L2S)", params.phyModel);
+    cmd.AddValue("phyCoherenceMhz", "eesm/miesm: independently faded subband width (MHz)", params.phyCoherenceMhz);
+    cmd.AddValue("obssPdLevel", "HE spatial reuse OBSS-PD level with BSS colours (dBm; 0 = off)", params.obssPdLevel);
+    cmd.AddValue("staSpeed", "STA waypoint speed (m/s; 0 = ns-3 default)", params.staSpeed);
+    cmd.AddValue("handoverPolicy", "Upload after a handover: resume or restart", params.handoverPolicy);
+    cmd.AddValue("bands", "One radio per band on every node, GHz:MHz list (e.g. 2.4:20,5:80,6:160)", params.bands);
+    cmd.AddValue("bandSplit", "Multi-band upload split: first, even, capacity or adaptive", params.bandSplit);
+    cmd.AddValue("flTopology", "FL topology: infra (AP server) or adhoc (gossip)", params.flTopology);
+    cmd.AddValue("gossipPeers", "Gossip peer selection: random, nearest or roundrobin", params.gossipPeers);
+    cmd.AddValue("gossipFanout", "Peers each station sends its model to per gossip round", params.gossipFanout);
+    cmd.AddValue("gossipRange", "Maximum gossip peer distance (m; 0 = any)", params.gossipRange);
+    cmd.AddValue("flProtocol", "FL protocol: fedavg or split", params.flProtocol);
+    cmd.AddValue("splitBatches", "Split learning mini-batches per client and round", params.splitBatches);
+    cmd.AddValue("activationBytes", "Split learning activation bytes per batch", params.activationBytes);
+    cmd.AddValue("gradientBytes", "Split learning gradient bytes per batch", params.gradientBytes);
+    cmd.AddValue("clientComputeTime", "Split learning client compute per batch (s)", params.clientComputeTime);
+    cmd.AddValue("serverComputeTime", "Split learning server compute per batch (s)", params.serverComputeTime);
+    cmd.AddValue("jobs", "Concurrent FL jobs: name:modelBytes:roundDeadline:clientFraction:weight,...", params.jobs);
+    cmd.AddValue("jobScheduling", "Airtime scheduling across jobs: drr or none", params.jobScheduling);
+    cmd.AddValue("jobQuantum", "Job scheduler quantum (s)", params.jobQuantum);
+    cmd.AddValue("clusters", "Clustered FL: cluster models at the AP (0 = one global model)", params.clusters);
+    cmd.AddValue("clusterDim", "Clustered FL: floats per update sketch", params.clusterDim);
+    cmd.AddValue("clusterGroups", "Clustered FL: client populations", params.clusterGroups);
+    cmd.AddValue("clusterNoise", "Clustered FL: sketch noise around the population centre", params.clusterNoise);
+    cmd.AddValue("clusterBatch", "Clustered FL: mini-batch k-means batch size", params.clusterBatch);
+    cmd.AddValue("clusterIterations", "Clustered FL: mini-batch k-means iterations per round", params.clusterIterations);
+    cmd.AddValue("downlinkRate", "Clustered FL: cluster-model broadcast pacing (Mb/s)", params.downlinkRate);
+    cmd.AddValue("joinSchedule", "STA join schedule: all, staggered, random or batched", params.joinSchedule);
+    cmd.AddValue("joinInterval", "Gap between staggered STAs or batches (s)", params.joinInterval);
+    cmd.AddValue("joinWindow", "Window for random joins (s)", params.joinWindow);
+    cmd.AddValue("joinBatchSize", "STAs per batch for batched joins", params.joinBatchSize);
+    cmd.AddValue("flStartFraction", "Fraction of associated STAs that starts FL", params.flStartFraction);
+    cmd.AddValue("flStartTimeout", "Time at which FL starts regardless of association (s)", params.flStartTimeout);
+    cmd.AddValue("mserBatch", "Batch size for MSER warm-up truncation", params.mserBatch);
+    cmd.AddValue("goodputBin", "Bin width of the goodput series (s)", params.goodputBin);
+    cmd.AddValue("staticArp", "Pre-populate ARP caches instead of resolving addresses on first use", params.staticArp);
+    cmd.AddValue("perClient", "Write per-client records (columnar binary)", params.perClient);
+    cmd.AddValue("staBatteryJ", "Initial STA battery energy (J)", params.staBatteryJ);
+    cmd.AddValue("metricsWindow", "Time-series window (s); 0 disables", params.metricsWindow);
+    cmd.AddValue("metricsCapacity", "Time-series windows kept in memory", params.metricsCapacity);
+    cmd.AddValue("liveTrace", "Write every metrics window to results_<mode>_live.csv during the run",
+                 params.liveTrace);
+    cmd.AddValue("availability", "Client availability: always, diurnal or trace", params.availability);
+    cmd.AddValue("dayLength", "Simulated seconds per 24 h (0 = simTime)", params.dayLength);
+    cmd.AddValue("dayStartHour", "Hour of day at t=0", params.dayStartHour);
+    cmd.AddValue("diurnalBase", "Mean diurnal availability probability", params.diurnalBase);
+    cmd.AddValue("diurnalAmplitude", "Diurnal availability swing", params.diurnalAmplitude);
+    cmd.AddValue("diurnalPeakHour", "Hour of peak availability", params.diurnalPeakHour);
+    cmd.AddValue("availabilitySlot", "Availability churn step (s; 0 = one simulated hour)", params.availabilitySlot);
+    cmd.AddValue("churnRate", "Per-slot churn rate (1 = independent draws)", params.churnRate);
+    cmd.AddValue("availabilityTrace", "Availability trace file (clientId start end per line)", params.availabilityTrace);
+}
+
+// Returns every global the previous scenario may have touched to its
+// start-of-process state: attribute defaults and open outputs (and with
+// them the created-file bookkeeping of LogToCsv). RunScenario reseeds RNGs.
+void ResetGlobalState() {
+    Config::Reset();
+    CloseOutputs();
+}
+
+// Parses args (argv[0] first) into a fresh parameter set after a reset, so
+// ns3:: attribute overrides in args apply to this scenario only.
+// Checks the scenario-wide settings shared by the command line and the
+// embedding API; topology and FL options are checked where they are used.
+static void ValidateParams(const SimulationParams &params) {
+    // The FL header carries chunk lengths as uint16.
+    NS_ABORT_MSG_IF(params.chunkBytes < 1 || params.chunkBytes > 65535,
+                    "chunkBytes must be in 1..65535, got " << params.chunkBytes);
+    OutputCompression compression;
+    NS_ABORT_MSG_IF(!ParseOutputCompression(params.compression, compression),
+                    "Unknown compression " << params.compression);
+    NS_ABORT_MSG_IF(!ValidCompressionLevel(compression, params.compressionLevel),
+                    "Compression level " << params.compressionLevel << " not valid for " << params.compression);
+    NS_ABORT_MSG_IF(!CompressorAvailable(compression), CompressorName(compression) << " not found on PATH");
+    NS_ABORT_MSG_IF(params.csvPrecision < 0 || params.csvPrecision > kMaxCsvPrecision,
+                    "csvPrecision must be in 0.." << kMaxCsvPrecision);
+}
+
+static SimulationParams PrepareScenario(const std::vector<std::string> &args) {
+    ResetGlobalState();
+
+    SimulationParams params;
+    CommandLine cmd;
+    AddParams(cmd, params);
+    cmd.Parse(args);
+    ValidateParams(params);
+
+    OutputOptions outputOptions;
+    ParseOutputCompression(params.compression, outputOptions.compression);
+    outputOptions.level = params.compressionLevel;
+    outputOptions.precision = params.csvPrecision;
+    outputOptions.asyncQueue = params.asyncQueue;
+    GetOutputs().SetOptions(outputOptions);
+    return params;
+}
+
+static std::vector<std::vector<std::string>> ReadScenarioFile(const std::string &filename) {
+    std::ifstream in(filename);
+    NS_ABORT_MSG_IF(!in, "Cannot open scenario file " << filename);
+    std::vector<std::vector<std::string>> scenarios;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream tokens(line);
+        std::vector<std::string> args;
+        std::string arg;
+        while (tokens >> arg) {
+            args.push_back(arg);
+        }
+        if (!args.empty() && args[0][0] != '#') {
+            scenarios.push_back(args);
+        }
+    }
+    return scenarios;
+}
+
+ResultSet RunScenario(const SimulationParams &params) {
+    ValidateParams(params);
+    RngSeedManager::SetSeed(params.seed);
+    RngSeedManager::SetRun(params.run);
+    // Streams of automatically created random variables are numbered from
+    // a process-wide counter; restart it so the scenario's position in a
+    // sweep does not change its streams.
+    RngSeedManager::ResetNextStreamIndex();
+    // The defaults (seed 1, run 1) reproduce the original failure sequence.
+    GetFailureRng().seed(params.seed + params.run - 1);
+
+    NS_LOG_UNCOND("Running simulation with nSta=" << params.nSta << ", dpEpsilon=" << params.dpEpsilon);
+
+    // ---------------- Metrics for All Modes ----------------
+    ResultSet results;
+    results.nStaValues = params.nStaValues;
+    for (const auto& mode : params.modes) {
+        ModeResult result;
+        result.mode = mode;
+
+        // Compute metrics for varying nSta
+        result.latency = ComputeLatency(params, mode, params.nSta);
+        result.throughput = ComputeThroughput(params, mode, params.nSta);
+        result.energyEfficiency = ComputeEnergyEfficiency(params, mode, params.nSta);
+        result.privacyLoss = ComputePrivacyLoss(params, mode, params.nSta);
+        result.robustness = ComputeRobustness(params, mode, params.nSta);
+        results.modes.push_back(result);
+    }
+
+    if (params.packetLevel) {
+        for (ModeResult &result : results.modes) {
+            result.packetLevel = params.flTopology == "adhoc" ? RunGossip(params, result.mode)
+                                                              : RunPacketLevel(params, result.mode, result.jobs);
+        }
+        return results;
+    }
+
+    BuildTopology(params);
+    Simulator::Stop(Seconds(params.simTime));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    return results;
+}
+
+// ---------------- Result Files ----------------
+static void WriteAvailability(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    double dayLength = params.dayLength > 0 ? params.dayLength : params.simTime;
+    for (size_t r = 0; r < pl.roundLatency.size(); ++r) {
+        double hour = std::fmod(params.dayStartHour + 24.0 * pl.roundStart[r] / dayLength, 24.0);
+        LogToCsv(prefix + "_availability.csv",
+                 "roundStartS,hourOfDay,available,selected,completed,participation,roundLatencyS",
+                 {pl.roundStart[r], hour, static_cast<double>(pl.roundAvailable[r]),
+                  static_cast<double>(pl.roundSelected[r]), static_cast<double>(pl.roundCompleted[r]),
+                  static_cast<double>(pl.roundCompleted[r]) / params.nSta, pl.roundLatency[r]});
+    }
+}
+
+static void WriteTimeSeries(const std::string &prefix, const PacketLevelResult &pl) {
+    for (const WindowSample &w : pl.timeSeries) {
+        LogToCsv(prefix + "_timeseries.csv", "timeS,throughputMbps,meanLatencyS,energyJ,activeClients",
+                 {w.time, w.throughputMbps, w.meanLatency, w.energyJ, static_cast<double>(w.activeClients)});
+    }
+}
+
+static void WriteClientRecords(const std::string &prefix, const PacketLevelResult &pl) {
+    bool created;
+    OutputSink &sink = GetOutputs().Get(prefix + "_clients.flcol", created);
+    NS_ABORT_MSG_IF(!sink.IsOpen(), "Cannot open output " << sink.Path());
+    ColumnarWriter writer(GetOutputs(), sink,
+                          {{"clientId", ColumnType::U32},
+                           {"roundsSelected", ColumnType::U32},
+                           {"updatesCompleted", ColumnType::U32},
+                           {"bytesSent", ColumnType::U64},
+                           {"rxBytes", ColumnType::U64},
+                           {"goodputMbps", ColumnType::F32},
+                           {"energyJ", ColumnType::F32},
+                           {"latencyP50S", ColumnType::F32},
+                           {"latencyP90S", ColumnType::F32},
+                           {"latencyP99S", ColumnType::F32},
+                           {"drops", ColumnType::U32},
+                           {"assocDelayS", ColumnType::F32},
+                           {"handovers", ColumnType::U32},
+                           {"lostBytes", ColumnType::U64},
+                           {"airtimeS", ColumnType::F32}});
+    for (size_t i = 0; i < pl.clients.size(); ++i) {
+        const ClientRecord &c = pl.clients[i];
+        writer.Append({static_cast<double>(i), static_cast<double>(c.roundsSelected),
+                       static_cast<double>(c.updatesCompleted), static_cast<double>(c.bytesSent),
+                       static_cast<double>(c.rxBytes), c.goodputMbps,
+                       c.energyJ, c.latencyP50, c.latencyP90, c.latencyP99,
+                       static_cast<double>(c.drops), pl.assocDelay[i], static_cast<double>(c.handovers),
+                       static_cast<double>(c.lostBytes), c.airtimeS});
+    }
+}
+
+static void WriteGossip(const std::string &prefix, const PacketLevelResult &pl) {
+    for (size_t r = 0; r < pl.roundLatency.size(); ++r) {
+        LogToCsv(prefix + "_gossip.csv", "roundStartS,available,exchanges,completed,roundLatencyS,modelSpread",
+                 {pl.roundStart[r], static_cast<double>(pl.roundAvailable[r]),
+                  static_cast<double>(pl.roundSelected[r]), static_cast<double>(pl.roundCompleted[r]),
+                  pl.roundLatency[r], pl.roundSpread[r]});
+    }
+}
+
+static void WriteSplit(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    std::vector<double> rttMs;
+    for (double rtt : pl.batchRtt) {
+        rttMs.push_back(rtt * 1e3);
+    }
+    double staAirtime = 0.0;
+    for (const ClientRecord &c : pl.clients) {
+        staAirtime += c.airtimeS;
+    }
+    double batches = static_cast<double>(pl.batchRtt.size());
+    LogToCsv(prefix + "_split.csv",
+             "nSta,batches,rttMeanMs,rttP50Ms,rttP95Ms,rttP99Ms,uplinkBytes,downlinkBytes,"
+             "staAirtimeS,apAirtimeS,airtimePerBatchMs",
+             {static_cast<double>(params.nSta), batches, Mean(rttMs), Percentile(rttMs, 0.5),
+              Percentile(rttMs, 0.95), Percentile(rttMs, 0.99), static_cast<double>(pl.rxBytes),
+              static_cast<double>(pl.txBytes), staAirtime, pl.apAirtime,
+              batches > 0 ? (staAirtime + pl.apAirtime) / batches * 1e3 : 0.0});
+}
+
+static void WriteHandovers(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    double handovers = 0;
+    double roamed = 0;
+    double lostBytes = 0;
+    double sentBytes = 0;
+    for (const ClientRecord &c : pl.clients) {
+        handovers += c.handovers;
+        roamed += c.handovers > 0;
+        lostBytes += c.lostBytes;
+        sentBytes += c.bytesSent;
+    }
+    LogToCsv(prefix + "_handover.csv",
+             "nSta,nAp,restart,handovers,clientsRoamed,gapMeanS,gapP95S,lostWorkBytes,lostWorkPct",
+             {static_cast<double>(params.nSta), static_cast<double>(params.nAp),
+              params.handoverPolicy == "restart" ? 1.0 : 0.0, handovers, roamed, Mean(pl.handoverGap),
+              Percentile(pl.handoverGap, 0.95), lostBytes, sentBytes > 0 ? 100.0 * lostBytes / sentBytes : 0.0});
+}
+
+static void WriteClusters(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    for (size_t r = 0; r < pl.clusterPurity.size(); ++r) {
+        LogToCsv(prefix + "_clusters.csv", "round,clients,selected,modelsReceived,clustered,purity,clusterMs",
+                 {static_cast<double>(r + 1), static_cast<double>(params.nSta), static_cast<double>(pl.roundSelected[r]),
+                  static_cast<double>(pl.roundModelsRx[r]), static_cast<double>(pl.roundClustered[r]),
+                  pl.clusterPurity[r], pl.clusterTimeMs[r]});
+    }
+}
+
+// Per round: how much of the selected clients' updates, and of their
+// value, reached the aggregator by the deadline.
+static void WritePartial(const std::string &prefix, const PacketLevelResult &pl) {
+    for (size_t r = 0; r < pl.roundLatency.size(); ++r) {
+        LogToCsv(prefix + "_partial.csv", "roundStartS,selected,completed,partial,receivedFraction,importanceCaptured",
+                 {pl.roundStart[r], static_cast<double>(pl.roundSelected[r]), static_cast<double>(pl.roundCompleted[r]),
+                  static_cast<double>(pl.roundPartial[r]), pl.roundReceived[r], pl.roundImportance[r]});
+    }
+}
+
+// Failed STA attempts (no ACK or no CTS) per STA transmission, which in
+// the hidden scenario's noiseless range channel are collisions.
+static void WriteHidden(const SimulationParams &params, const std::string &prefix, const std::string &mode,
+                        const PacketLevelResult &pl) {
+    double failures = static_cast<double>(pl.dataFailures + pl.rtsFailures);
+    LogToCsv(prefix + "_hidden.csv",
+             "nSta,hiddenFraction,hiddenPairs,rtsCtsThreshold,staTx,dataFailures,rtsFailures,collisionRate,"
+             "updateLatencyMeanS,updateLatencyP95S,completedUpdates",
+             {static_cast<double>(params.nSta), params.hiddenFraction, pl.hiddenPairs,
+              static_cast<double>(RtsCtsThreshold(params, mode)), static_cast<double>(pl.staTxAttempts),
+              static_cast<double>(pl.dataFailures), static_cast<double>(pl.rtsFailures),
+              pl.staTxAttempts > 0 ? failures / pl.staTxAttempts : 0.0, Mean(pl.updateLatency),
+              Percentile(pl.updateLatency, 0.95), static_cast<double>(pl.updateLatency.size())});
+}
+
+// Aggregate FL goodput per deployment area, the figure of merit for
+// dense multi-BSS layouts.
+static void WriteDensity(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    double area = DeploymentArea(params);
+    LogToCsv(prefix + "_density.csv",
+             "nSta,nAp,grid,channelWidthMhz,obssPdLevelDbm,areaM2,goodputMbps,mbpsPer1000m2,meanRoundLatencyS,apAirtimeS",
+             {static_cast<double>(params.nSta), static_cast<double>(params.nAp), params.apLayout == "grid" ? 1.0 : 0.0,
+              static_cast<double>(params.channelWidth), params.obssPdLevel, area, pl.goodputMbps,
+              area > 0 ? pl.goodputMbps / area * 1000.0 : 0.0, Mean(pl.roundLatency), pl.apAirtime});
+}
+
+// Utilization is the AP radio's busy share of the whole run, per band.
+static void WriteBands(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    double rxTotal = 0.0;
+    for (const BandResult &band : pl.bands) {
+        rxTotal += band.rxBytes;
+    }
+    for (const BandResult &band : pl.bands) {
+        LogToCsv(prefix + "_bands.csv", "ghz,widthMhz,rxBytes,rxShare,apTxS,staTxS,busyS,utilization",
+                 {band.ghz, static_cast<double>(band.widthMhz), static_cast<double>(band.rxBytes),
+                  rxTotal > 0 ? band.rxBytes / rxTotal : 0.0, band.apTxS, band.staTxS, band.busyS,
+                  band.busyS / params.simTime});
+    }
+}
+
+static void WriteSubmodel(const std::string &prefix, const PacketLevelResult &pl) {
+    for (size_t r = 0; r < pl.roundLatency.size(); ++r) {
+        LogToCsv(prefix + "_submodel.csv",
+                 "roundStartS,selected,completed,meanFraction,blockCoverage,minBlockUpdates,roundLatencyS",
+                 {pl.roundStart[r], static_cast<double>(pl.roundSelected[r]), static_cast<double>(pl.roundCompleted[r]),
+                  pl.roundSubmodel[r], pl.roundCoverage[r], pl.roundMinCover[r], pl.roundLatency[r]});
+    }
+}
+
+// Per-client goodput and airtime spread: starved clients show up in the
+// minimum and 5th percentile even when the aggregate looks healthy.
+static void WriteFairness(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    std::vector<double> goodput;
+    std::vector<double> airtime;
+    for (const ClientRecord &c : pl.clients) {
+        goodput.push_back(c.goodputMbps);
+        airtime.push_back(c.airtimeS);
+    }
+    LogToCsv(prefix + "_fairness.csv",
+             "nSta,jainGoodput,minGoodputMbps,p5GoodputMbps,meanGoodputMbps,jainAirtime,minAirtimeS,p5AirtimeS",
+             {static_cast<double>(params.nSta), JainIndex(goodput), Percentile(goodput, 0.0),
+              Percentile(goodput, 0.05), Mean(goodput), JainIndex(airtime), Percentile(airtime, 0.0),
+              Percentile(airtime, 0.05)});
+}
+
+// Frame errors and run cost of the link-to-system PHY model.
+static void WritePhy(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    double started = static_cast<double>(pl.apRxFrames + pl.apRxDropped);
+    LogToCsv(prefix + "_phy.csv", "nSta,coherenceMhz,apRxFrames,apRxDropped,frameErrorRate,goodputMbps,wallS",
+             {static_cast<double>(params.nSta), params.phyCoherenceMhz, static_cast<double>(pl.apRxFrames),
+              static_cast<double>(pl.apRxDropped), started > 0 ? pl.apRxDropped / started : 0.0,
+              pl.goodputMbps, pl.wallS});
+}
+
+// Start-up control overhead: ARP traffic and how long the first round took.
+static void WriteControl(const SimulationParams &params, const std::string &prefix, const PacketLevelResult &pl) {
+    LogToCsv(prefix + "_control.csv", "nSta,staticArp,arpFrames,arpBytes,flStartS,firstRoundLatencyS",
+             {static_cast<double>(params.nSta), params.staticArp ? 1.0 : 0.0, static_cast<double>(pl.arpFrames),
+              static_cast<double>(pl.arpBytes), pl.flStartTime,
+              pl.roundLatency.empty() ? 0.0 : pl.roundLatency.front()});
+}
+
+static void WritePacketLevelSummary(const SimulationParams &params, const std::string &prefix,
+                                    const PacketLevelResult &pl) {
+    std::vector<double> assocMs;
+    for (double delay : pl.assocDelay) {
+        if (delay >= 0) {
+            assocMs.push_back(delay * 1e3);
+        }
+    }
+    double completed = 0;
+    for (uint32_t n : pl.roundCompleted) {
+        completed += n;
+    }
+    LogToCsv(prefix + "_fl.csv",
+             "nSta,associated,assocMeanMs,assocP50Ms,assocP95Ms,assocMaxMs,flStartS,rounds,"
+             "meanRoundLatencyS,completedUpdates,goodputMbps",
+             {static_cast<double>(params.nSta), static_cast<double>(assocMs.size()), Mean(assocMs),
+              Percentile(assocMs, 0.5), Percentile(assocMs, 0.95), Percentile(assocMs, 1.0),
+              pl.flStartTime, static_cast<double>(pl.roundLatency.size()), Mean(pl.roundLatency),
+              completed, pl.goodputMbps});
+
+    // Steady-state view: each stream loses its MSER-detected warm-up.
+    SteadyState rounds = ComputeSteadyState(pl.roundLatency, params.mserBatch);
+    SteadyState updates = ComputeSteadyState(pl.updateLatency, params.mserBatch);
+    SteadyState goodput = ComputeSteadyState(pl.goodputSeries, params.mserBatch);
+    LogToCsv(prefix + "_steady.csv",
+             "nSta,roundWarmup,roundLatencySteadyS,updateWarmup,updateLatencySteadyS,"
+             "goodputWarmupS,goodputSteadyMbps",
+             {static_cast<double>(params.nSta), static_cast<double>(rounds.truncated), rounds.mean,
+              static_cast<double>(updates.truncated), updates.mean,
+              goodput.truncated * params.goodputBin, goodput.mean});
+}
+
+static void WriteJobs(const SimulationParams &params, const std::string &prefix, const ModeResult &result) {
+    double granted = 0.0;
+    double measured = 0.0;
+    for (const JobResult &job : result.jobs) {
+        granted += job.airtimeGranted;
+        measured += job.airtimeMeasured;
+    }
+    for (size_t j = 0; j < result.jobs.size(); ++j) {
+        const JobResult &job = result.jobs[j];
+        const PacketLevelResult &pl = job.result;
+        double completed = 0;
+        for (uint32_t n : pl.roundCompleted) {
+            completed += n;
+        }
+        LogToCsv(prefix + "_jobs.csv",
+                 "job,weight,clients,rounds,completedUpdates,meanRoundLatencyS,meanUpdateLatencyS,"
+                 "goodputMbps,airtimeShare,airtimeS,grantedShare",
+                 {static_cast<double>(j), job.weight, static_cast<double>(job.clients),
+                  static_cast<double>(pl.roundLatency.size()), completed, Mean(pl.roundLatency),
+                  Mean(pl.updateLatency), pl.goodputMbps, measured > 0 ? job.airtimeMeasured / measured : 0.0,
+                  job.airtimeMeasured, granted > 0 ? job.airtimeGranted / granted : 0.0});
+        WritePacketLevelSummary(params, prefix + "_job_" + job.name, pl);
+        WriteFairness(params, prefix + "_job_" + job.name, pl);
+    }
+}
+
+static void WriteResults(const SimulationParams &params, const ResultSet &results) {
+    std::string header;
+    for (uint32_t n : results.nStaValues) {
+        header += (header.empty() ? "nSta=" : ",nSta=") + std::to_string(n);
+    }
+    for (const ModeResult &result : results.modes) {
+        std::string prefix = params.outputPrefix + "results_" + result.mode;
+        LogToCsv(prefix + "_latency.csv", header, result.latency);
+        LogToCsv(prefix + "_throughput.csv", header, result.throughput);
+        LogToCsv(prefix + "_energy.csv", header, result.energyEfficiency);
+        LogToCsv(prefix + "_privacy.csv", header, result.privacyLoss);
+        LogToCsv(prefix + "_robustness.csv", header, result.robustness);
+
+        if (params.packetLevel) {
+            WritePacketLevelSummary(params, prefix, result.packetLevel);
+            WriteFairness(params, prefix, result.packetLevel);
+            WriteControl(params, prefix, result.packetLevel);
+            WriteTimeSeries(prefix, result.packetLevel);
+            if (params.availability != "always") {
+                WriteAvailability(params, prefix, result.packetLevel);
+            }
+            if (params.perClient) {
+                WriteClientRecords(prefix, result.packetLevel);
+            }
+            if (params.flProtocol == "split") {
+                WriteSplit(params, prefix, result.packetLevel);
+            }
+            if (params.flProtocol == "fedavg" && params.flTopology == "infra") {
+                WritePartial(prefix, result.packetLevel);
+                if (params.submodel == "dropout") {
+                    WriteSubmodel(prefix, result.packetLevel);
+                }
+            }
+            if (params.flTopology == "infra" &&
+                (params.nAp > 1 || params.channelWidth != 0 || params.obssPdLevel != 0.0)) {
+                WriteDensity(params, prefix, result.packetLevel);
+            }
+            if (params.flTopology == "infra" && params.phyModel != "table") {
+                WritePhy(params, prefix, result.packetLevel);
+            }
+            if (params.hiddenFraction >= 0.0) {
+                WriteHidden(params, prefix, result.mode, result.packetLevel);
+            }
+            if (!result.packetLevel.bands.empty()) {
+                WriteBands(params, prefix, result.packetLevel);
+            }
+            if (params.clusters > 0) {
+                WriteClusters(params, prefix, result.packetLevel);
+            }
+            if (!result.jobs.empty()) {
+                WriteJobs(params, prefix, result);
+            }
+            if (params.flTopology == "adhoc") {
+                WriteGossip(prefix, result.packetLevel);
+            } else if (params.nAp > 1) {
+                WriteHandovers(params, prefix, result.packetLevel);
+            }
+        }
+
+        NS_LOG_UNCOND("Metrics logged for mode=" << result.mode);
+    }
+    CloseOutputs();
+}
+
+// ---------------- Main Simulation ----------------
+#ifndef FL_AITP_NO_MAIN
+int main(int argc, char *argv[]) {
+    // A compressor child that dies must surface as an output error, not kill us.
+    std::signal(SIGPIPE, SIG_IGN);
+    std::vector<std::string> args(argv, argv + argc);
+    SimulationParams params = PrepareScenario(args);
+
+    if (params.scenarioFile.empty()) {
+        WriteResults(params, RunScenario(params));
+        return 0;
+    }
+
+    // Each scenario line is applied on top of the process arguments and
+    // runs in this process after a full reset.
+    std::vector<std::vector<std::string>> scenarios = ReadScenarioFile(params.scenarioFile);
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        std::vector<std::string> scenarioArgs = args;
+        scenarioArgs.insert(scenarioArgs.end(), scenarios[i].begin(), scenarios[i].end());
+        SimulationParams scenario = PrepareScenario(scenarioArgs);
+        if (scenario.outputPrefix.empty()) {
+            scenario.outputPrefix = "scenario" + std::to_string(i) + "_";
+        }
+        NS_LOG_UNCOND("Scenario " << i + 1 << "/" << scenarios.size());
+        WriteResults(scenario, RunScenario(scenario));
+    }
+
+    return 0;
+}
+#endif // FL_AITP_NO_MAIN
@@ -0,0 +1,92 @@
+#ifndef FL_CLIENT_TABLE_H
+#define FL_CLIENT_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ---------------- Client Table ----------------
+// Per-client state of the FL and gossip coordinators as a struct of arrays
+// indexed by client id. Round-level passes (selection, end-of-round
+// accounting, result collection) touch one or two columns across every
+// client, so each column is a contiguous array: with 10k+ clients a pass
+// streams a few tens of KB instead of striding over per-client objects.
+// Flags are uint8_t rather than vector<bool>, so the passes read plain
+// bytes instead of shifting and masking bits. ns-3 handles (events, times,
+// addresses) stay with the coordinator.
+struct FlClientTable {
+    explicit FlClientTable(size_t n = 0) { Resize(n); }
+
+    void Resize(size_t n) {
+        associated.assign(n, 0);
+        available.assign(n, 1);
+        selected.assign(n, 0);
+        assocTime.assign(n, -1.0);
+        deassocTime.assign(n, -1.0);
+        roundsSelected.assign(n, 0);
+        handovers.assign(n, 0);
+        lastActiveWindow.assign(n, UINT32_MAX);
+        rxBytes.assign(n, 0);
+        computeFactor.assign(n, 1.0);
+        rate.assign(n, -1.0);
+        fraction.assign(n, 1.0);
+        payload.assign(n, 0);
+        blockStart.assign(n, 0);
+        partsLeft.assign(n, 0);
+        batch.assign(n, 0);
+        cluster.assign(n, 0);
+    }
+
+    size_t Size() const { return selected.size(); }
+
+    // Selects every associated, available client; returns the number available.
+    uint32_t Select() {
+        size_t n = Size();
+        uint32_t nAvailable = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t s = associated[i] & available[i];
+            selected[i] = s;
+            roundsSelected[i] += s;
+            nAvailable += available[i];
+        }
+        return nAvailable;
+    }
+
+    uint32_t CountSelected() const {
+        uint32_t count = 0;
+        for (uint8_t s : selected) {
+            count += s;
+        }
+        return count;
+    }
+
+    // Sum of column over the selected clients.
+    double SumSelected(const std::vector<double> &column) const {
+        size_t n = Size();
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += selected[i] ? column[i] : 0.0;
+        }
+        return sum;
+    }
+
+    std::vector<uint8_t> associated;
+    std::vector<uint8_t> available;
+    std::vector<uint8_t> selected;         // asked for an update this round, not yet complete
+    std::vector<double> assocTime;         // first association (s); -1 never
+    std::vector<double> deassocTime;       // last loss of the AP (s); -1 never
+    std::vector<uint32_t> roundsSelected;
+    std::vector<uint32_t> handovers;
+    std::vector<uint32_t> lastActiveWindow; // last metrics window with payload from the client
+    std::vector<uint64_t> rxBytes;          // FL payload received by the server
+    std::vector<double> computeFactor;      // local training slowdown
+    std::vector<double> rate;               // uplink payload rate on the last update (B/s); -1 unknown
+    std::vector<double> fraction;           // sub-model fraction this round
+    std::vector<uint32_t> payload;          // update payload this round
+    std::vector<uint32_t> blockStart;       // first model block of the sub-model
+    std::vector<uint32_t> partsLeft;        // update shares still in flight
+    std::vector<uint32_t> batch;            // split learning: current mini-batch
+    std::vector<uint32_t> cluster;          // latest cluster
+};
+
+#endif // FL_CLIENT_TABLE_H
@@ -0,0 +1,204 @@
+#ifndef FL_CLUSTER_H
+#define FL_CLUSTER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+// ---------------- Distance Kernel ----------------
+// Squared Euclidean distances between n points and k centroids, both
+// row-major with dim floats per row, written to out (n x k). Uses
+// |x - c|^2 = |x|^2 + |c|^2 - 2 x.c, with the dot products computed in
+// dimension tiles so a tile of every centroid stays in cache while the
+// points stream past. The innermost loops keep kFlLanes independent
+// accumulators, which compilers turn into SIMD code without -ffast-math.
+static const size_t kFlLanes = 8;
+static const size_t kFlDimTile = 4096;
+
+// Dot product of a and b over len floats.
+inline float FlDot(const float *a, const float *b, size_t len) {
+    float acc[kFlLanes] = {};
+    size_t d = 0;
+    for (; d + kFlLanes <= len; d += kFlLanes) {
+        for (size_t l = 0; l < kFlLanes; ++l) {
+            acc[l] += a[d + l] * b[d + l];
+        }
+    }
+    float sum = 0.0f;
+    for (; d < len; ++d) {
+        sum += a[d] * b[d];
+    }
+    for (size_t l = 0; l < kFlLanes; ++l) {
+        sum += acc[l];
+    }
+    return sum;
+}
+
+inline void SquaredDistances(const float *points, size_t n, const float *centroids, size_t k, size_t dim,
+                             float *out) {
+    std::vector<float> pointNorm(n, 0.0f);
+    std::vector<float> centroidNorm(k, 0.0f);
+    std::fill(out, out + n * k, 0.0f);
+    for (size_t d0 = 0; d0 < dim; d0 += kFlDimTile) {
+        size_t len = std::min(kFlDimTile, dim - d0);
+        for (size_t j = 0; j < k; ++j) {
+            centroidNorm[j] += FlDot(centroids + j * dim + d0, centroids + j * dim + d0, len);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const float *x = points + i * dim + d0;
+            pointNorm[i] += FlDot(x, x, len);
+            for (size_t j = 0; j < k; ++j) {
+                out[i * k + j] += FlDot(x, centroids + j * dim + d0, len);
+            }
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < k; ++j) {
+            out[i * k + j] = std::max(0.0f, pointNorm[i] + centroidNorm[j] - 2.0f * out[i * k + j]);
+        }
+    }
+}
+
+// Reference kernel: one point-centroid pair at a time, scalar accumulation.
+inline void SquaredDistancesNaive(const float *points, size_t n, const float *centroids, size_t k, size_t dim,
+                                  float *out) {
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < k; ++j) {
+            float sum = 0.0f;
+            for (size_t d = 0; d < dim; ++d) {
+                float diff = points[i * dim + d] - centroids[j * dim + d];
+                sum += diff * diff;
+            }
+            out[i * k + j] = sum;
+        }
+    }
+}
+
+// ---------------- Mini-Batch k-Means ----------------
+// Sculley-style mini-batch k-means: each iteration assigns a random batch
+// to the nearest centroids and moves every centroid towards its points with
+// a per-centroid learning rate of 1 / (points seen). Centroids persist
+// across Fit() calls, so later rounds warm-start from the previous fit;
+// the first call seeds them with k-means++.
+class MiniBatchKMeans {
+public:
+    MiniBatchKMeans(size_t k, size_t dim, size_t batch, size_t iterations, uint32_t seed)
+        : m_k(k), m_dim(dim), m_batch(batch), m_iterations(iterations), m_rng(seed), m_counts(k, 0) {}
+
+    void Fit(const float *points, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        if (m_centroids.empty()) {
+            SeedCentroids(points, n);
+        }
+        size_t batch = std::min(m_batch, n);
+        std::vector<float> rows(batch * m_dim);
+        std::vector<uint32_t> labels(batch);
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        for (size_t it = 0; it < m_iterations; ++it) {
+            for (size_t b = 0; b < batch; ++b) {
+                std::copy_n(points + pick(m_rng) * m_dim, m_dim, rows.begin() + b * m_dim);
+            }
+            Assign(rows.data(), batch, labels.data());
+            for (size_t b = 0; b < batch; ++b) {
+                float *c = &m_centroids[labels[b] * m_dim];
+                const float *x = &rows[b * m_dim];
+                float eta = 1.0f / ++m_counts[labels[b]];
+                for (size_t d = 0; d < m_dim; ++d) {
+                    c[d] += eta * (x[d] - c[d]);
+                }
+            }
+        }
+    }
+
+    // Nearest-centroid label for each of n points.
+    void Assign(const float *points, size_t n, uint32_t *labels) const {
+        size_t k = m_centroids.size() / m_dim;
+        m_distances.resize(n * k);
+        SquaredDistances(points, n, m_centroids.data(), k, m_dim, m_distances.data());
+        for (size_t i = 0; i < n; ++i) {
+            const float *row = &m_distances[i * k];
+            labels[i] = static_cast<uint32_t>(std::min_element(row, row + k) - row);
+        }
+    }
+
+    size_t Clusters() const { return m_centroids.size() / m_dim; }
+    const std::vector<float> &Centroids() const { return m_centroids; }
+
+private:
+    // Greedy k-means++: each further centroid is the best of 2 + ln k
+    // points drawn with probability proportional to their squared distance
+    // from the nearest centroid so far, judged by the resulting potential.
+    void SeedCentroids(const float *points, size_t n) {
+        size_t k = std::min(m_k, n);
+        size_t trials = 2 + static_cast<size_t>(std::log(static_cast<double>(k)));
+        size_t start = std::uniform_int_distribution<size_t>(0, n - 1)(m_rng);
+        m_centroids.assign(points + start * m_dim, points + (start + 1) * m_dim);
+        std::vector<float> nearest(n);
+        SquaredDistances(points, n, m_centroids.data(), 1, m_dim, nearest.data());
+        std::vector<float> dist(n);
+        std::vector<float> best(n);
+        for (size_t c = 1; c < k; ++c) {
+            double total = 0.0;
+            for (float d : nearest) {
+                total += d;
+            }
+            double bestPotential = std::numeric_limits<double>::max();
+            size_t bestPoint = 0;
+            for (size_t t = 0; t < trials; ++t) {
+                size_t next = 0;
+                double r = std::uniform_real_distribution<double>(0.0, total)(m_rng);
+                while (next + 1 < n && (r -= nearest[next]) > 0.0) {
+                    ++next;
+                }
+                SquaredDistances(points, n, points + next * m_dim, 1, m_dim, dist.data());
+                double potential = 0.0;
+                for (size_t i = 0; i < n; ++i) {
+                    dist[i] = std::min(dist[i], nearest[i]);
+                    potential += dist[i];
+                }
+                if (potential < bestPotential) {
+                    bestPotential = potential;
+                    bestPoint = next;
+                    best.swap(dist);
+                }
+            }
+            nearest.swap(best);
+            m_centroids.insert(m_centroids.end(), points + bestPoint * m_dim, points + (bestPoint + 1) * m_dim);
+        }
+    }
+
+    size_t m_k;
+    size_t m_dim;
+    size_t m_batch;
+    size_t m_iterations;
+    std::mt19937 m_rng;
+    std::vector<float> m_centroids; // Clusters() x dim
+    std::vector<uint64_t> m_counts;
+    mutable std::vector<float> m_distances;
+};
+
+// ---------------- Cluster Quality ----------------
+// Fraction of points whose label's majority true group is their own group.
+inline double ClusterPurity(const std::vector<uint32_t> &labels, const std::vector<uint32_t> &groups,
+                            size_t clusters, size_t nGroups) {
+    if (labels.empty()) {
+        return 0.0;
+    }
+    std::vector<uint32_t> counts(clusters * nGroups, 0);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        ++counts[labels[i] * nGroups + groups[i]];
+    }
+    size_t correct = 0;
+    for (size_t c = 0; c < clusters; ++c) {
+        correct += *std::max_element(counts.begin() + c * nGroups, counts.begin() + (c + 1) * nGroups);
+    }
+    return static_cast<double>(correct) / labels.size();
+}
+
+#endif // FL_CLUSTER_H
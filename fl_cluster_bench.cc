@@ -0,0 +1,86 @@
+#include "ns3/core-module.h"
+#include "fl_cluster.h"
+#include <chrono>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("FL_Cluster_Bench");
+
+static double Millis(std::chrono::steady_clock::time_point start) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+// ---------------- Main ----------------
+// Clustering cost at the AP: clients x dim float updates drawn around
+// `groups` random centres, clustered with mini-batch k-means.
+int main(int argc, char *argv[]) {
+    uint32_t clients = 500;
+    uint32_t dim = 1000000;
+    uint32_t clusters = 4;
+    uint32_t groups = 4;
+    uint32_t batch = 64;
+    uint32_t iterations = 20;
+    double noise = 1.0;
+    uint32_t seed = 1;
+
+    CommandLine cmd;
+    cmd.AddValue("clients", "Number of client updates", clients);
+    cmd.AddValue("dim", "Parameters per update", dim);
+    cmd.AddValue("clusters", "Clusters k", clusters);
+    cmd.AddValue("groups", "True client groups in the synthetic data", groups);
+    cmd.AddValue("batch", "Mini-batch size", batch);
+    cmd.AddValue("iterations", "Mini-batch iterations", iterations);
+    cmd.AddValue("noise", "Per-parameter noise around the group centre", noise);
+    cmd.AddValue("seed", "RNG seed", seed);
+    cmd.Parse(argc, argv);
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> centres(static_cast<size_t>(groups) * dim);
+    for (float &c : centres) {
+        c = normal(rng);
+    }
+    std::vector<float> updates(static_cast<size_t>(clients) * dim);
+    std::vector<uint32_t> truth(clients);
+    for (uint32_t i = 0; i < clients; ++i) {
+        truth[i] = i % groups;
+        const float *centre = &centres[static_cast<size_t>(truth[i]) * dim];
+        float *row = &updates[static_cast<size_t>(i) * dim];
+        for (uint32_t d = 0; d < dim; ++d) {
+            row[d] = centre[d] + static_cast<float>(noise) * normal(rng);
+        }
+    }
+
+    // Assignment pass against the true centres with both kernels.
+    std::vector<float> distances(static_cast<size_t>(clients) * groups);
+    auto start = std::chrono::steady_clock::now();
+    SquaredDistancesNaive(updates.data(), clients, centres.data(), groups, dim, distances.data());
+    double naiveMs = Millis(start);
+    float checksum = distances[0];
+    start = std::chrono::steady_clock::now();
+    SquaredDistances(updates.data(), clients, centres.data(), groups, dim, distances.data());
+    double blockedMs = Millis(start);
+    checksum -= distances[0];
+
+    MiniBatchKMeans kmeans(clusters, dim, batch, iterations, seed);
+    start = std::chrono::steady_clock::now();
+    kmeans.Fit(updates.data(), clients);
+    double fitMs = Millis(start);
+    std::vector<uint32_t> labels(clients);
+    start = std::chrono::steady_clock::now();
+    kmeans.Assign(updates.data(), clients, labels.data());
+    double assignMs = Millis(start);
+
+    double gflop = 2.0 * clients * groups * dim / 1e9;
+    NS_LOG_UNCOND("clients=" << clients << " dim=" << dim << " clusters=" << clusters << " checksum=" << checksum);
+    NS_LOG_UNCOND("step,ms,gflops");
+    NS_LOG_UNCOND("distances_naive," << naiveMs << "," << gflop / (naiveMs / 1e3));
+    NS_LOG_UNCOND("distances_blocked," << blockedMs << "," << gflop / (blockedMs / 1e3));
+    NS_LOG_UNCOND("kmeans_fit," << fitMs << ",");
+    NS_LOG_UNCOND("kmeans_assign," << assignMs << ",");
+    NS_LOG_UNCOND("purity=" << ClusterPurity(labels, truth, kmeans.Clusters(), groups));
+
+    return 0;
+}
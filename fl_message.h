@@ -0,0 +1,178 @@
+#ifndef FL_MESSAGE_H
+#define FL_MESSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ---------------- FL Message Layout ----------------
+// Fixed 48-byte little-endian header carried in front of every FL payload
+// chunk. Every field sits at a constant offset, so a receiver reads it in
+// place from the packet bytes through FlMessageView without a decode pass.
+//
+//  off  size  field
+//    0     2  magic (0xF17A)
+//    2     1  version
+//    3     1  type (FlMessageType)
+//    4     4  clientId
+//    8     4  round
+//   12     4  modelVersion    mini-batch index for Activation/Gradient,
+//                              cluster index for a clustered GlobalModel
+//   16     4  rawBytes        uncompressed update size
+//   20     4  payloadBytes    on-air update size after compression
+//   24     4  chunkOffset     offset of this chunk inside the payload
+//   28     2  chunkBytes      payload bytes following this header
+//   30     1  codec (FlCodec)
+//   31     1  flags (FlMessageFlags)
+//   32     4  dpEpsilon       float32
+//   36     4  dpDelta         float32
+//   40     4  dpNoiseMultiplier float32
+//   44     4  dpClipNorm      float32
+
+static const uint16_t kFlMessageMagic = 0xF17A;
+static const uint8_t kFlMessageVersion = 1;
+static const uint32_t kFlMessageSize = 48;
+
+enum class FlMessageType : uint8_t {
+    ModelUpdate = 1,
+    GlobalModel = 2,
+    Activation = 3, // split learning: cut-layer activations, client to server
+    Gradient = 4,   // split learning: cut-layer gradients, server to client
+};
+
+enum class FlCodec : uint8_t {
+    None = 0,
+    Fp16 = 1,
+    Int8 = 2,
+    TopK = 3,
+};
+
+enum FlMessageFlags : uint8_t {
+    FL_FLAG_DP = 0x01,         // update carries differential privacy noise
+    FL_FLAG_LAST_CHUNK = 0x02, // final chunk of the update (or of this link's share)
+    FL_FLAG_IMPORTANCE = 0x04, // chunks in decreasing importance; any prefix is usable
+};
+
+// Host-side values used to build a message.
+struct FlMessageFields {
+    FlMessageType type = FlMessageType::ModelUpdate;
+    uint32_t clientId = 0;
+    uint32_t round = 0;
+    uint32_t modelVersion = 0;
+    uint32_t rawBytes = 0;
+    uint32_t payloadBytes = 0;
+    uint32_t chunkOffset = 0;
+    uint16_t chunkBytes = 0;
+    FlCodec codec = FlCodec::None;
+    uint8_t flags = 0;
+    float dpEpsilon = 0.0f;
+    float dpDelta = 0.0f;
+    float dpNoiseMultiplier = 0.0f;
+    float dpClipNorm = 0.0f;
+};
+
+// ---------------- Byte Order Helpers ----------------
+// memcpy keeps the accesses alignment-safe; on little-endian hosts the
+// compiler lowers each helper to a single load or store.
+inline uint16_t FlLoadLe16(const uint8_t *p) {
+    uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap16(v);
+#endif
+    return v;
+}
+
+inline uint32_t FlLoadLe32(const uint8_t *p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline float FlLoadLeF32(const uint8_t *p) {
+    uint32_t bits = FlLoadLe32(p);
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline void FlStoreLe16(uint8_t *p, uint16_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap16(v);
+#endif
+    std::memcpy(p, &v, sizeof(v));
+}
+
+inline void FlStoreLe32(uint8_t *p, uint32_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    std::memcpy(p, &v, sizeof(v));
+}
+
+inline void FlStoreLeF32(uint8_t *p, float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    FlStoreLe32(p, bits);
+}
+
+// ---------------- Writer ----------------
+// Writes the fixed header into out, which must hold kFlMessageSize bytes.
+inline void WriteFlMessage(uint8_t *out, const FlMessageFields &f) {
+    FlStoreLe16(out + 0, kFlMessageMagic);
+    out[2] = kFlMessageVersion;
+    out[3] = static_cast<uint8_t>(f.type);
+    FlStoreLe32(out + 4, f.clientId);
+    FlStoreLe32(out + 8, f.round);
+    FlStoreLe32(out + 12, f.modelVersion);
+    FlStoreLe32(out + 16, f.rawBytes);
+    FlStoreLe32(out + 20, f.payloadBytes);
+    FlStoreLe32(out + 24, f.chunkOffset);
+    FlStoreLe16(out + 28, f.chunkBytes);
+    out[30] = static_cast<uint8_t>(f.codec);
+    out[31] = f.flags;
+    FlStoreLeF32(out + 32, f.dpEpsilon);
+    FlStoreLeF32(out + 36, f.dpDelta);
+    FlStoreLeF32(out + 40, f.dpNoiseMultiplier);
+    FlStoreLeF32(out + 44, f.dpClipNorm);
+}
+
+// ---------------- Reader ----------------
+// Non-owning view over a serialized header. Fields are decoded on access,
+// so reading only clientId and round touches only those bytes.
+class FlMessageView {
+public:
+    FlMessageView(const uint8_t *data, size_t size) : m_data(data), m_size(size) {}
+
+    bool IsValid() const {
+        return m_size >= kFlMessageSize && FlLoadLe16(m_data) == kFlMessageMagic &&
+               m_data[2] == kFlMessageVersion;
+    }
+
+    FlMessageType Type() const { return static_cast<FlMessageType>(m_data[3]); }
+    uint32_t ClientId() const { return FlLoadLe32(m_data + 4); }
+    uint32_t Round() const { return FlLoadLe32(m_data + 8); }
+    uint32_t ModelVersion() const { return FlLoadLe32(m_data + 12); }
+    uint32_t RawBytes() const { return FlLoadLe32(m_data + 16); }
+    uint32_t PayloadBytes() const { return FlLoadLe32(m_data + 20); }
+    uint32_t ChunkOffset() const { return FlLoadLe32(m_data + 24); }
+    uint16_t ChunkBytes() const { return FlLoadLe16(m_data + 28); }
+    FlCodec Codec() const { return static_cast<FlCodec>(m_data[30]); }
+    uint8_t Flags() const { return m_data[31]; }
+    float DpEpsilon() const { return FlLoadLeF32(m_data + 32); }
+    float DpDelta() const { return FlLoadLeF32(m_data + 36); }
+    float DpNoiseMultiplier() const { return FlLoadLeF32(m_data + 40); }
+    float DpClipNorm() const { return FlLoadLeF32(m_data + 44); }
+
+    // Chunk payload directly following the header.
+    const uint8_t *Payload() const { return m_data + kFlMessageSize; }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+};
+
+#endif // FL_MESSAGE_H
@@ -0,0 +1,156 @@
+#include "ns3/core-module.h"
+#include "fl_message.h"
+#include <chrono>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("FL_Message_Bench");
+
+// ---------------- Naive Byte-Stream Encoding ----------------
+// Tag/length/value stream built byte by byte and parsed back into a struct,
+// as a straightforward serializer would do. Used as the baseline only.
+static void AppendField(std::vector<uint8_t> &out, uint8_t tag, const void *value, uint8_t len) {
+    out.push_back(tag);
+    out.push_back(len);
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    for (uint8_t i = 0; i < len; ++i) {
+        out.push_back(bytes[i]);
+    }
+}
+
+static void EncodeNaive(std::vector<uint8_t> &out, const FlMessageFields &f) {
+    uint8_t type = static_cast<uint8_t>(f.type);
+    uint8_t codec = static_cast<uint8_t>(f.codec);
+    AppendField(out, 1, &type, sizeof(type));
+    AppendField(out, 2, &f.clientId, sizeof(f.clientId));
+    AppendField(out, 3, &f.round, sizeof(f.round));
+    AppendField(out, 4, &f.modelVersion, sizeof(f.modelVersion));
+    AppendField(out, 5, &f.rawBytes, sizeof(f.rawBytes));
+    AppendField(out, 6, &f.payloadBytes, sizeof(f.payloadBytes));
+    AppendField(out, 7, &f.chunkOffset, sizeof(f.chunkOffset));
+    AppendField(out, 8, &f.chunkBytes, sizeof(f.chunkBytes));
+    AppendField(out, 9, &codec, sizeof(codec));
+    AppendField(out, 10, &f.flags, sizeof(f.flags));
+    AppendField(out, 11, &f.dpEpsilon, sizeof(f.dpEpsilon));
+    AppendField(out, 12, &f.dpDelta, sizeof(f.dpDelta));
+    AppendField(out, 13, &f.dpNoiseMultiplier, sizeof(f.dpNoiseMultiplier));
+    AppendField(out, 14, &f.dpClipNorm, sizeof(f.dpClipNorm));
+}
+
+static size_t DecodeNaive(const uint8_t *data, size_t size, FlMessageFields &f) {
+    size_t pos = 0;
+    while (pos + 2 <= size) {
+        uint8_t tag = data[pos];
+        uint8_t len = data[pos + 1];
+        const uint8_t *value = data + pos + 2;
+        switch (tag) {
+        case 1: f.type = static_cast<FlMessageType>(value[0]); break;
+        case 2: std::memcpy(&f.clientId, value, len); break;
+        case 3: std::memcpy(&f.round, value, len); break;
+        case 4: std::memcpy(&f.modelVersion, value, len); break;
+        case 5: std::memcpy(&f.rawBytes, value, len); break;
+        case 6: std::memcpy(&f.payloadBytes, value, len); break;
+        case 7: std::memcpy(&f.chunkOffset, value, len); break;
+        case 8: std::memcpy(&f.chunkBytes, value, len); break;
+        case 9: f.codec = static_cast<FlCodec>(value[0]); break;
+        case 10: f.flags = value[0]; break;
+        case 11: std::memcpy(&f.dpEpsilon, value, len); break;
+        case 12: std::memcpy(&f.dpDelta, value, len); break;
+        case 13: std::memcpy(&f.dpNoiseMultiplier, value, len); break;
+        case 14: std::memcpy(&f.dpClipNorm, value, len); break;
+        }
+        pos += 2 + len;
+        if (tag == 14) {
+            break;
+        }
+    }
+    return pos;
+}
+
+static FlMessageFields MakeFields(uint32_t i) {
+    FlMessageFields f;
+    f.clientId = i % 500;
+    f.round = i / 500;
+    f.modelVersion = f.round;
+    f.rawBytes = 400000;
+    f.payloadBytes = 100000;
+    f.chunkOffset = (i % 100) * 1000;
+    f.chunkBytes = 1000;
+    f.codec = FlCodec::Int8;
+    f.flags = FL_FLAG_DP;
+    f.dpEpsilon = 1.0f;
+    f.dpDelta = 1e-5f;
+    f.dpNoiseMultiplier = 1.1f;
+    f.dpClipNorm = 1.0f;
+    return f;
+}
+
+static double NsPerMessage(std::chrono::steady_clock::time_point start, uint32_t count) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+}
+
+// ---------------- Main ----------------
+int main(int argc, char *argv[]) {
+    uint32_t messages = 1000000;
+    uint32_t chunkBytes = 1000;
+
+    CommandLine cmd;
+    cmd.AddValue("messages", "Number of messages to encode and decode", messages);
+    cmd.AddValue("chunkBytes", "Payload bytes per message for overhead reporting", chunkBytes);
+    cmd.Parse(argc, argv);
+
+    std::vector<FlMessageFields> input;
+    input.reserve(messages);
+    for (uint32_t i = 0; i < messages; ++i) {
+        input.push_back(MakeFields(i));
+    }
+
+    // Fixed layout: encode into one contiguous buffer, read fields in place.
+    std::vector<uint8_t> fixed(static_cast<size_t>(messages) * kFlMessageSize);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < messages; ++i) {
+        WriteFlMessage(fixed.data() + static_cast<size_t>(i) * kFlMessageSize, input[i]);
+    }
+    double fixedEncode = NsPerMessage(start, messages);
+
+    uint64_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < messages; ++i) {
+        FlMessageView view(fixed.data() + static_cast<size_t>(i) * kFlMessageSize, kFlMessageSize);
+        if (view.IsValid()) {
+            checksum += view.ClientId() + view.Round() + view.ChunkOffset();
+        }
+    }
+    double fixedRead = NsPerMessage(start, messages);
+
+    // Naive stream: append per field, parse the whole message to read it.
+    std::vector<uint8_t> naive;
+    std::vector<size_t> offsets;
+    offsets.reserve(messages);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < messages; ++i) {
+        offsets.push_back(naive.size());
+        EncodeNaive(naive, input[i]);
+    }
+    double naiveEncode = NsPerMessage(start, messages);
+    double naiveSize = static_cast<double>(naive.size()) / messages;
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < messages; ++i) {
+        FlMessageFields f;
+        DecodeNaive(naive.data() + offsets[i], naive.size() - offsets[i], f);
+        checksum -= f.clientId + f.round + f.chunkOffset;
+    }
+    double naiveRead = NsPerMessage(start, messages);
+
+    NS_LOG_UNCOND("messages=" << messages << " checksum=" << checksum);
+    NS_LOG_UNCOND("format,bytesPerMsg,encodeNsPerMsg,readNsPerMsg,headerOverheadPct");
+    NS_LOG_UNCOND("fixed," << kFlMessageSize << "," << fixedEncode << "," << fixedRead << ","
+                           << 100.0 * kFlMessageSize / (kFlMessageSize + chunkBytes));
+    NS_LOG_UNCOND("naive," << naiveSize << "," << naiveEncode << "," << naiveRead << ","
+                           << 100.0 * naiveSize / (naiveSize + chunkBytes));
+
+    return 0;
+}
@@ -0,0 +1,479 @@
+#ifndef FL_OUTPUT_H
+#define FL_OUTPUT_H
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// ---------------- Output Options ----------------
+enum class OutputCompression {
+    None,
+    Gzip,
+    Zstd,
+};
+
+struct OutputOptions {
+    OutputCompression compression = OutputCompression::None;
+    int level = 3;     // gzip 1-9, zstd 1-19
+    int precision = 0; // significant digits, 0..kMaxCsvPrecision; 0 = shortest round-trip
+    size_t asyncQueue = 0; // records queued for the writer thread; 0 = synchronous
+};
+
+inline bool ParseOutputCompression(const std::string &name, OutputCompression &out) {
+    if (name == "none") {
+        out = OutputCompression::None;
+    } else if (name == "gzip") {
+        out = OutputCompression::Gzip;
+    } else if (name == "zstd") {
+        out = OutputCompression::Zstd;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Levels the compressor accepts without extra flags (zstd needs --ultra above 19).
+inline bool ValidCompressionLevel(OutputCompression compression, int level) {
+    switch (compression) {
+    case OutputCompression::Gzip: return level >= 1 && level <= 9;
+    case OutputCompression::Zstd: return level >= 1 && level <= 19;
+    default: return true;
+    }
+}
+
+inline const char *CompressorName(OutputCompression compression) {
+    return compression == OutputCompression::Gzip ? "gzip" : "zstd";
+}
+
+// Whether the compressor binary is on PATH; checked before a run so a
+// missing tool fails fast instead of after the simulation.
+inline bool CompressorAvailable(OutputCompression compression) {
+    if (compression == OutputCompression::None) {
+        return true;
+    }
+    std::string cmd = std::string("command -v ") + CompressorName(compression) + " > /dev/null 2>&1";
+    return std::system(cmd.c_str()) == 0;
+}
+
+inline std::string OutputSuffix(OutputCompression compression) {
+    switch (compression) {
+    case OutputCompression::Gzip: return ".gz";
+    case OutputCompression::Zstd: return ".zst";
+    default: return "";
+    }
+}
+
+// ---------------- Line Formatting ----------------
+// 17 significant digits already round-trip any double.
+static const int kMaxCsvPrecision = 17;
+
+// Builds one output line in a buffer that is reused across calls. Numbers
+// go through std::to_chars, which ignores the locale and, at precision 0,
+// prints the shortest text that parses back to the identical double.
+class CsvLine {
+public:
+    explicit CsvLine(int precision = 0) { SetPrecision(precision); }
+
+    void SetPrecision(int precision) { m_precision = std::min(std::max(precision, 0), kMaxCsvPrecision); }
+    void Clear() { m_line.clear(); }
+
+    void Append(const std::string &text) { m_line += text; }
+    void Append(char c) { m_line += c; }
+
+    void Append(double value) {
+        char buf[32];
+        std::to_chars_result res = m_precision > 0
+                                       ? std::to_chars(buf, buf + sizeof(buf), value,
+                                                       std::chars_format::general, m_precision)
+                                       : std::to_chars(buf, buf + sizeof(buf), value);
+        if (res.ec != std::errc()) {
+            res = std::to_chars(buf, buf + sizeof(buf), value); // shortest form always fits
+        }
+        m_line.append(buf, res.ptr);
+    }
+
+    void Append(uint64_t value) {
+        char buf[24];
+        std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), value);
+        m_line.append(buf, res.ptr);
+    }
+
+    const std::string &Str() const { return m_line; }
+
+private:
+    int m_precision;
+    std::string m_line;
+};
+
+// ---------------- Output Sink ----------------
+// One open output file. Compressed sinks stream through a gzip/zstd child
+// process, so compression runs in parallel with the simulator and the
+// program needs no compression library at link time. The process should
+// ignore SIGPIPE (main does; an embedder decides for itself) so a
+// compressor that dies turns into a write error reported by Close()
+// rather than killing the process.
+class OutputSink {
+public:
+    OutputSink(const std::string &path, const OutputOptions &options)
+        : m_path(path + OutputSuffix(options.compression)),
+          m_pipe(options.compression != OutputCompression::None) {
+        if (!m_pipe) {
+            m_file = std::fopen(m_path.c_str(), "w");
+        } else {
+            std::string tool = options.compression == OutputCompression::Gzip ? "gzip" : "zstd -q";
+            std::string cmd = tool + " -" + std::to_string(options.level) + " -c > " + ShellQuote(m_path);
+            m_file = popen(cmd.c_str(), "w");
+        }
+        if (m_file) {
+            std::setvbuf(m_file, nullptr, _IOFBF, 1 << 16);
+        }
+    }
+
+    ~OutputSink() { Close(); }
+
+    OutputSink(const OutputSink &) = delete;
+    OutputSink &operator=(const OutputSink &) = delete;
+
+    bool IsOpen() const { return m_file != nullptr; }
+    const std::string &Path() const { return m_path; }
+
+    void Write(const char *data, size_t size) {
+        if (m_file && std::fwrite(data, 1, size, m_file) != size) {
+            m_failed = true;
+        }
+    }
+
+    void Write(const std::string &text) { Write(text.data(), text.size()); }
+
+    void Flush() {
+        if (m_file && std::fflush(m_file) != 0) {
+            m_failed = true;
+        }
+    }
+
+    // Returns false if the file or the compressor reported an error.
+    bool Close() {
+        if (!m_file) {
+            return true;
+        }
+        int status = m_pipe ? pclose(m_file) : std::fclose(m_file);
+        m_file = nullptr;
+        return status == 0 && !m_failed;
+    }
+
+private:
+    static std::string ShellQuote(const std::string &s) {
+        std::string quoted = "'";
+        for (char c : s) {
+            if (c == '\'') {
+                quoted += "'\\''";
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "'";
+    }
+
+    std::string m_path;
+    bool m_pipe;
+    std::FILE *m_file = nullptr;
+    bool m_failed = false; // a write or flush came up short
+};
+
+// ---------------- Async Writer ----------------
+// Single-producer/single-consumer ring of output records. The simulator
+// thread fills a slot in place (reusing its string capacity) and publishes
+// it with a release store; the writer thread drains slots into their sinks.
+class AsyncOutputWriter {
+public:
+    struct Stats {
+        uint64_t records = 0;
+        uint64_t fullStalls = 0;   // pushes that found the ring full
+        uint64_t stallMicros = 0;  // time the producer spent waiting
+        size_t maxOccupancy = 0;
+    };
+
+    explicit AsyncOutputWriter(size_t capacity) : m_slots(RoundUpPow2(capacity)) {
+        m_mask = m_slots.size() - 1;
+        m_thread = std::thread([this] { Drain(); });
+    }
+
+    ~AsyncOutputWriter() {
+        Flush();
+        m_stop.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+
+    AsyncOutputWriter(const AsyncOutputWriter &) = delete;
+    AsyncOutputWriter &operator=(const AsyncOutputWriter &) = delete;
+
+    // Producer side; only ever called from the simulator thread.
+    void Push(OutputSink *sink, const std::string &text) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+            ++m_stats.fullStalls;
+            auto start = std::chrono::steady_clock::now();
+            while (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+                std::this_thread::yield();
+            }
+            m_stats.stallMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+                                       std::chrono::steady_clock::now() - start)
+                                       .count();
+        }
+        Record &slot = m_slots[head & m_mask];
+        slot.sink = sink;
+        slot.text.assign(text);
+        m_head.store(head + 1, std::memory_order_release);
+
+        ++m_stats.records;
+        size_t occupancy = head + 1 - m_tail.load(std::memory_order_relaxed);
+        if (occupancy > m_stats.maxOccupancy) {
+            m_stats.maxOccupancy = occupancy;
+        }
+    }
+
+    // Blocks until every pushed record has been handed to its sink.
+    void Flush() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        while (m_tail.load(std::memory_order_acquire) != head) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Returns the counters since the last call and starts new ones.
+    Stats TakeStats() {
+        Stats stats = m_stats;
+        m_stats = Stats();
+        return stats;
+    }
+
+private:
+    struct Record {
+        OutputSink *sink = nullptr;
+        std::string text;
+    };
+
+    static size_t RoundUpPow2(size_t n) {
+        size_t p = 2;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    void Drain() {
+        uint32_t idle = 0;
+        while (true) {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire)) {
+                if (m_stop.load(std::memory_order_acquire)) {
+                    return;
+                }
+                // Back off from spinning to short sleeps while idle.
+                if (++idle < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+                continue;
+            }
+            idle = 0;
+            Record &slot = m_slots[tail & m_mask];
+            slot.sink->Write(slot.text);
+            m_tail.store(tail + 1, std::memory_order_release);
+        }
+    }
+
+    std::vector<Record> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    std::atomic<bool> m_stop{false};
+    Stats m_stats;
+    std::thread m_thread;
+};
+
+// ---------------- Output Registry ----------------
+// Keeps every result/trace file open for the run. The first Get() for a
+// name creates (truncates) the file; later calls append to the same sink.
+class OutputRegistry {
+public:
+    void SetOptions(const OutputOptions &options) {
+        m_options = options;
+        m_async.reset();
+        if (options.asyncQueue > 0) {
+            m_async = std::make_unique<AsyncOutputWriter>(options.asyncQueue);
+        }
+    }
+
+    const OutputOptions &GetOptions() const { return m_options; }
+    // Writer counters since the last call; all zero when writes are synchronous.
+    AsyncOutputWriter::Stats TakeAsyncStats() {
+        return m_async ? m_async->TakeStats() : AsyncOutputWriter::Stats();
+    }
+
+    // Writes text to sink directly or through the writer thread.
+    void Write(OutputSink &sink, const std::string &text) {
+        if (m_async) {
+            m_async->Push(&sink, text);
+        } else {
+            sink.Write(text);
+        }
+    }
+
+    // Waits for queued records and flushes every sink.
+    void Flush() {
+        if (m_async) {
+            m_async->Flush();
+        }
+        for (auto &entry : m_sinks) {
+            entry.second->Flush();
+        }
+    }
+
+    // Returns the sink for filename and whether it was created by this call.
+    OutputSink &Get(const std::string &filename, bool &created) {
+        auto it = m_sinks.find(filename);
+        created = it == m_sinks.end();
+        if (created) {
+            it = m_sinks.emplace(filename, std::make_unique<OutputSink>(filename, m_options)).first;
+        }
+        return *it->second;
+    }
+
+    // Closes all sinks; returns the paths that failed to close cleanly.
+    std::string CloseAll() {
+        if (m_async) {
+            m_async->Flush();
+        }
+        std::string failed;
+        for (auto &entry : m_sinks) {
+            if (!entry.second->Close()) {
+                failed += entry.second->Path() + " ";
+            }
+        }
+        m_sinks.clear();
+        return failed;
+    }
+
+private:
+    OutputOptions m_options;
+    std::map<std::string, std::unique_ptr<OutputSink>> m_sinks;
+    std::unique_ptr<AsyncOutputWriter> m_async; // destroyed (joined) before the sinks
+};
+
+// ---------------- Columnar Writer ----------------
+// Compact binary record stream. Rows are buffered per column and written
+// as row groups, so memory stays bounded at any client count and readers
+// can load one column without touching the others. Little-endian layout:
+//
+//   "FLCOL1\0\0"                          8-byte magic
+//   u32 columnCount
+//   columnCount x { u8 type, u8 nameLen, name }
+//   row groups: u32 rows, then each column's rows back to back
+//   terminator: u32 0
+enum class ColumnType : uint8_t {
+    U32 = 0,
+    U64 = 1,
+    F32 = 2,
+    F64 = 3,
+};
+
+struct ColumnSpec {
+    std::string name;
+    ColumnType type;
+};
+
+class ColumnarWriter {
+public:
+    ColumnarWriter(OutputRegistry &outputs, OutputSink &sink, const std::vector<ColumnSpec> &columns,
+                   uint32_t groupRows = 4096)
+        : m_outputs(outputs), m_sink(sink), m_columns(columns), m_data(columns.size()),
+          m_groupRows(groupRows) {
+        std::string header("FLCOL1\0\0", 8);
+        AppendLe(header, static_cast<uint32_t>(columns.size()));
+        for (const ColumnSpec &column : columns) {
+            header += static_cast<char>(column.type);
+            header += static_cast<char>(column.name.size());
+            header += column.name;
+        }
+        m_outputs.Write(m_sink, header);
+    }
+
+    ~ColumnarWriter() { Finish(); }
+
+    ColumnarWriter(const ColumnarWriter &) = delete;
+    ColumnarWriter &operator=(const ColumnarWriter &) = delete;
+
+    // values[i] is converted to the type of column i.
+    void Append(const std::vector<double> &values) {
+        for (size_t i = 0; i < m_columns.size(); ++i) {
+            double v = i < values.size() ? values[i] : 0.0;
+            switch (m_columns[i].type) {
+            case ColumnType::U32: AppendLe(m_data[i], static_cast<uint32_t>(v)); break;
+            case ColumnType::U64: AppendLe(m_data[i], static_cast<uint64_t>(v)); break;
+            case ColumnType::F32: AppendLe(m_data[i], static_cast<float>(v)); break;
+            case ColumnType::F64: AppendLe(m_data[i], v); break;
+            }
+        }
+        if (++m_rows == m_groupRows) {
+            WriteGroup();
+        }
+    }
+
+    void Finish() {
+        if (m_finished) {
+            return;
+        }
+        WriteGroup();
+        std::string end;
+        AppendLe(end, static_cast<uint32_t>(0));
+        m_outputs.Write(m_sink, end);
+        m_finished = true;
+    }
+
+private:
+    template <typename T>
+    static void AppendLe(std::string &out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        std::reverse(bytes, bytes + sizeof(T));
+#endif
+        out.append(bytes, sizeof(T));
+    }
+
+    void WriteGroup() {
+        if (m_rows == 0) {
+            return;
+        }
+        std::string group;
+        AppendLe(group, m_rows);
+        for (std::string &column : m_data) {
+            group += column;
+            column.clear();
+        }
+        m_outputs.Write(m_sink, group);
+        m_rows = 0;
+    }
+
+    OutputRegistry &m_outputs;
+    OutputSink &m_sink;
+    std::vector<ColumnSpec> m_columns;
+    std::vector<std::string> m_data;
+    uint32_t m_groupRows;
+    uint32_t m_rows = 0;
+    bool m_finished = false;
+};
+
+#endif // FL_OUTPUT_H
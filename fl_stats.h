@@ -0,0 +1,122 @@
+#ifndef FL_STATS_H
+#define FL_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// ---------------- Summary Statistics ----------------
+inline double Mean(const std::vector<double> &values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    return sum / values.size();
+}
+
+// Nearest-rank percentile, q in [0, 1]. Takes a copy so callers keep order.
+inline double Percentile(std::vector<double> values, double q) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(q * values.size()));
+    size_t index = rank == 0 ? 0 : rank - 1;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Jain's fairness index (sum x)^2 / (n sum x^2): 1 when all values are
+// equal, 1/n when one value takes everything. 1 for an all-zero input.
+inline double JainIndex(const std::vector<double> &values) {
+    double sum = 0.0;
+    double sumSq = 0.0;
+    for (double v : values) {
+        sum += v;
+        sumSq += v * v;
+    }
+    return sumSq > 0.0 ? sum * sum / (values.size() * sumSq) : 1.0;
+}
+
+// ---------------- Ring Buffer ----------------
+// Fixed-capacity buffer that keeps the newest items; pushing into a full
+// ring overwrites the oldest one. Index 0 is the oldest retained item.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) : m_items(std::max<size_t>(capacity, 1)) {}
+
+    void Push(const T &item) {
+        m_items[m_next % m_items.size()] = item;
+        ++m_next;
+    }
+
+    size_t Size() const { return std::min(m_next, m_items.size()); }
+    size_t Overwritten() const { return m_next - Size(); }
+
+    const T &operator[](size_t i) const { return m_items[(m_next - Size() + i) % m_items.size()]; }
+
+private:
+    std::vector<T> m_items;
+    size_t m_next = 0;
+};
+
+// ---------------- Warm-up Detection ----------------
+// MSER-m truncation: batch the series into means of m samples and pick the
+// cut d (at most half the batches) minimising the standard error of the
+// remaining batches, sum_{i>=d} (Y_i - mean_d)^2 / (k - d)^2. Returns the
+// number of leading samples to discard. Suffix sums keep it O(n).
+inline size_t MserTruncation(const std::vector<double> &series, size_t batch = 5) {
+    if (batch == 0 || series.size() < 2 * batch) {
+        return 0;
+    }
+    size_t k = series.size() / batch;
+    std::vector<double> y(k);
+    for (size_t i = 0; i < k; ++i) {
+        double sum = 0.0;
+        for (size_t j = 0; j < batch; ++j) {
+            sum += series[i * batch + j];
+        }
+        y[i] = sum / batch;
+    }
+
+    double sum = 0.0;
+    double sumSq = 0.0;
+    size_t best = 0;
+    double bestStat = 0.0;
+    // Walk d from k-1 down to 0, growing the suffix [d, k).
+    for (size_t d = k; d-- > 0;) {
+        sum += y[d];
+        sumSq += y[d] * y[d];
+        if (d > k / 2) {
+            continue;
+        }
+        double n = static_cast<double>(k - d);
+        double ss = std::max(0.0, sumSq - sum * sum / n);
+        double stat = ss / (n * n);
+        if (d == k / 2 || stat <= bestStat) {
+            bestStat = stat;
+            best = d;
+        }
+    }
+    return best * batch;
+}
+
+// Steady-state summary of a metric stream after MSER truncation.
+struct SteadyState {
+    size_t truncated = 0;   // samples discarded as warm-up
+    double mean = 0.0;      // mean of the remaining samples
+    double fullMean = 0.0;  // mean including the warm-up
+};
+
+inline SteadyState ComputeSteadyState(const std::vector<double> &series, size_t batch = 5) {
+    SteadyState st;
+    st.truncated = MserTruncation(series, batch);
+    st.mean = Mean(std::vector<double>(series.begin() + st.truncated, series.end()));
+    st.fullMean = Mean(series);
+    return st;
+}
+
+#endif // FL_STATS_H